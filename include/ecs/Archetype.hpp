@@ -1,6 +1,8 @@
 #pragma once
 
+#include <limits>
 #include <memory>
+#include <unordered_map>
 #include <utility>
 
 #include "ArchetypeChunk.hpp"
@@ -14,11 +16,36 @@ namespace EVA::ECS
         using ChunkVector = std::vector<std::shared_ptr<ArchetypeChunk>>;
         template <typename> class Iterator;
 
+        // Cached transition to the archetype with one component added or removed
+        struct Edge
+        {
+            static constexpr Index None = std::numeric_limits<Index>::max();
+
+            Index archetype = None;
+            ColumnMap columns;
+        };
+
+        // The first chunk is MinChunkSize, each new chunk doubles in size until chunkSize is reached
         explicit Archetype(const ComponentList& components, size_t chunkSize = DefaultChunkSize);
 
         std::pair<Index, Index> CreateEntity(const Entity& entity);
         std::pair<Index, Index> CreateEntity(const Entity& entity, const Byte* data);
+
+        // Fill chunks a range at a time, onCreated(chunk, firstIndexInChunk, entities) is called for each range
+        template <typename Func> void CreateEntities(std::span<const Entity> entities, const Byte* data, Func&& onCreated);
+
+        // Copy every entity of a chunk of another archetype, onMoved(chunk, firstIndexInChunk, entities) is called for each range
+        template <typename Func>
+        void AddEntities(Archetype& otherArchetype, const Index otherChunk, const ColumnMap& columns, const Byte* data, Func&& onMoved);
+
         Entity DestroyEntity(const Index chunk, const Index indexInChunk);
+        // Remove every entity at once and release the spare chunks
+        void Clear();
+
+        /* Swap chunks with an archetype that has the same columns, only tags may differ
+         * This archetype must be empty, it gets every entity of other and other gets its empty chunks
+         */
+        void TakeChunks(Archetype& other);
         Entity& GetEntity(const Index chunk, const Index indexInChunk);
 
         inline Index EntityCount() const { return m_EntityCount; }
@@ -27,11 +54,19 @@ namespace EVA::ECS
         inline const ArchetypeInfo& GetInfo() const { return m_ArchetypeInfo; }
         inline const ComponentList& GetComponents() const { return m_Components; }
 
+        std::pair<Index, Index>
+        AddEntity(Archetype& otherArchetype, const Index otherChunk, const Index otherIndexInChunk, const ColumnMap& columns, const Byte* data);
         std::pair<Index, Index>
         AddEntityAddComponent(Archetype& otherArchetype, const Index otherChunk, const Index otherIndexInChunk, const ComponentType newType, const Byte* data);
         std::pair<Index, Index>
         AddEntityRemoveComponent(Archetype& otherArchetype, const Index otherChunk, const Index otherIndexInChunk, const ComponentType removeType);
 
+        // Edge slots are created on demand and have archetype set to Edge::None until the engine fills them in
+        Edge& GetAddEdge(const ComponentType type);
+        Edge& GetRemoveEdge(const ComponentType type);
+        // Same for transitions that change several components at once, keyed by the components of the target
+        Edge& GetChangeEdge(const ComponentList& target) { return m_ChangeEdges[target]; }
+
         Byte* GetComponent(const ComponentType type, const Index chunk, const Index indexInChunk);
         Byte* GetComponent(const Index archetypeComponentIndex, const Index chunk, const Index indexInChunk);
         template <typename T> inline T& GetComponent(const Index chunk, const Index indexInChunk)
@@ -51,16 +86,103 @@ namespace EVA::ECS
         Byte* GetComponent(const Index archetypeComponentIndex, const Index index);
         template <typename T> inline T& GetComponent(const Index index) { return *FromBytes<T>(GetComponent(T::GetType(), index)); }
 
+        // Fill partially filled chunks from the back and release every empty chunk except the first.
+        // onMoved(entity, chunk, indexInChunk) is called for each entity that changed position
+        template <typename Func> void ShrinkToFit(Func&& onMoved);
+
         ChunkVector m_Chunks;
 
+        // Empty chunks kept after the active one, trimmed with hysteresis as entities are destroyed
+        static constexpr Index MinSpareChunks = 1;
+
       private:
         ComponentList m_Components;
         ArchetypeInfo m_ArchetypeInfo;
+        std::vector<ArchetypeInfo> m_GrowthInfos; // Layouts of the chunks smaller than chunkSize, in order
+        std::vector<Edge> m_AddEdges;             // Indexed by ComponentType value
+        std::vector<Edge> m_RemoveEdges;          // Indexed by ComponentType value
+        std::unordered_map<ComponentList, Edge> m_ChangeEdges;
         Index m_EntityCount;
 
         ChunkVector::difference_type m_ActiveChunkIndex;
 
         void AddChunk();
+        const ArchetypeInfo& GetChunkInfo(Index chunk) const;
         void ReserveChunk();
+        void ReleaseSpareChunks();
+
+        // Chunk index and index in chunk of the index:th entity in the archetype
+        std::pair<Index, Index> GetChunkPosition(Index index) const;
     };
+
+    template <typename Func> void Archetype::CreateEntities(std::span<const Entity> entities, const Byte* data, Func&& onCreated)
+    {
+        while (!entities.empty())
+        {
+            ReserveChunk();
+
+            auto& chunk      = *m_Chunks[m_ActiveChunkIndex];
+            const auto count = std::min(entities.size(), chunk.Capacity() - chunk.Count());
+            const auto first = chunk.CreateEntities(entities.first(count), data);
+            m_EntityCount += count;
+
+            onCreated(ActiveChunkIndex(), first, entities.first(count));
+            entities = entities.subspan(count);
+        }
+    }
+
+    template <typename Func>
+    void Archetype::AddEntities(Archetype& otherArchetype, const Index otherChunk, const ColumnMap& columns, const Byte* data, Func&& onMoved)
+    {
+        const auto& from = *otherArchetype.m_Chunks[otherChunk];
+        for (Index moved = 0; moved < from.Count();)
+        {
+            ReserveChunk();
+
+            auto& chunk      = *m_Chunks[m_ActiveChunkIndex];
+            const auto count = std::min(from.Count() - moved, chunk.Capacity() - chunk.Count());
+            const auto first = chunk.AddEntities(columns, from, moved, count, data);
+            m_EntityCount += count;
+            moved += count;
+
+            onMoved(ActiveChunkIndex(), first, std::span<const Entity>(chunk.template GetColumn<Entity>().subspan(first, count)));
+        }
+    }
+
+    template <typename Func> void Archetype::ShrinkToFit(Func&& onMoved)
+    {
+        Index into = 0;
+        auto from  = static_cast<Index>(m_ActiveChunkIndex);
+
+        while (into < from)
+        {
+            auto& intoChunk = *m_Chunks[into];
+            auto& fromChunk = *m_Chunks[from];
+
+            if (intoChunk.Full())
+            {
+                into++;
+                continue;
+            }
+            if (fromChunk.Empty())
+            {
+                from--;
+                continue;
+            }
+
+            const auto indexInChunk = intoChunk.Count();
+            intoChunk.CreateEntity(fromChunk.GetEntity(fromChunk.Count() - 1));
+            intoChunk.CopyEntity(indexInChunk, fromChunk, fromChunk.Count() - 1);
+            fromChunk.RemoveLast();
+
+            onMoved(intoChunk.GetEntity(indexInChunk), into, indexInChunk);
+        }
+
+        m_ActiveChunkIndex = static_cast<ChunkVector::difference_type>(from);
+        if (m_Chunks[from]->Empty() && from != 0)
+        {
+            --m_ActiveChunkIndex;
+        }
+        m_Chunks.resize(m_ActiveChunkIndex + 1);
+    }
 } // namespace EVA::ECS
@@ -1,5 +1,11 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+
 #include "Component.hpp"
 #include "Core.hpp"
 #include "OptionalRef.hpp"
@@ -18,13 +24,37 @@ namespace EVA::ECS
      *        ^componentInfo[0].start
      *                ^componentInfo[1].start
      *                        ^componentInfo[2].start
+     *
+     * Every column starts on a cache line boundary (or the component's alignment if larger),
+     * and the chunk buffer itself is taken from the ChunkPool with ArchetypeInfo::alignment
+     *
+     * Tags (empty components) come after the columns in componentInfo with a size of 0
+     * and take up no space in the chunk
      */
 
+    /* Source of the versions chunk columns are stamped with when written, shared by every engine
+     * Writes outside of a system update use the current version. Each system update takes the next one and bumps it
+     * again when it is done, so a column written after a system ran always has a newer version than the system saw.
+     */
+    class ChangeVersion
+    {
+      public:
+        static inline Version Current() { return s_Version.load(std::memory_order_relaxed); }
+        static inline Version Next() { return s_Version.fetch_add(1, std::memory_order_relaxed) + 1; }
+
+      private:
+        inline static std::atomic<Version> s_Version{ 1 };
+    };
+
     struct ComponentInfo
     {
+        static constexpr std::uint16_t NoMask = std::numeric_limits<std::uint16_t>::max();
+
         ComponentType type{ 0 };
         size_t size{ 0 };
+        size_t alignment{ 0 };
         size_t start{ 0 };
+        std::uint16_t mask{ NoMask }; // Index of the enabled mask for enableable components
 
         // Allow finding a ComponentInfo by the ComponentType
         struct Predicate
@@ -40,24 +70,73 @@ namespace EVA::ECS
         size_t chunkSize{ 0 };
         size_t entitySize{ 0 };
         size_t entitiesPerChunk{ 0 };
+        size_t alignment{ 0 };
+        size_t columnCount{ 0 }; // componentInfo entries with data, the rest are tags
         std::vector<ComponentInfo> componentInfo;
 
+        ComponentList enableable;
+        size_t maskWords{ 0 }; // Words in each enabled mask, one bit per entity
+
+        // Index into componentInfo for each ComponentType value up to the largest one in the archetype
+        static constexpr std::uint16_t NoComponent = std::numeric_limits<std::uint16_t>::max();
+        std::vector<std::uint16_t> componentIndices;
+
         explicit ArchetypeInfo(const ComponentList& componentList, size_t _chunkSize = DefaultChunkSize);
-        std::optional<Index> GetComponentIndex(ComponentType type) const;
+
+        inline std::optional<Index> GetComponentIndex(ComponentType type) const
+        {
+            if (type.Get() >= componentIndices.size() || componentIndices[type.Get()] == NoComponent)
+                return std::nullopt;
+            return componentIndices[type.Get()];
+        }
+
+        // The number of bytes the aligned columns occupy when holding entityCount entities
+        size_t DataSize(Index entityCount) const;
+
+        // The same components laid out in a chunk of a different size
+        ArchetypeInfo WithChunkSize(size_t _chunkSize) const;
+
+        // The smallest chunk size that fits entityCount entities with the given components
+        static size_t ChunkSizeFor(const ComponentList& componentList, Index entityCount);
+
+      private:
+        void UpdateLayout();
     };
 
+    // Which columns to copy when an entity moves from one archetype to another
+    struct ColumnMap
+    {
+        std::vector<std::pair<Index, Index>> copy; // Column in the source and in the destination
+        std::vector<Index> added;                  // Destination columns without a source, in ComponentType order
+
+        static ColumnMap Create(const ArchetypeInfo& from, const ArchetypeInfo& to);
+    };
+
+    /* Enableable components get one bit per entity in an enabled mask next to the chunk data. A set bit means the
+     * component is enabled, bits past the entity count are undefined.
+     */
     class ArchetypeChunk
     {
       public:
+        using MaskWord = std::uint64_t;
+        static constexpr size_t MaskWordBits = sizeof(MaskWord) * 8;
+
         template <typename> class Iterator;
 
         explicit ArchetypeChunk(ArchetypeInfo archetypeInfo);
+        ~ArchetypeChunk();
+
+        ArchetypeChunk(const ArchetypeChunk&)            = delete;
+        ArchetypeChunk& operator=(const ArchetypeChunk&) = delete;
 
         Index CreateEntity(const Entity& entity);
         Index CreateEntity(const Entity& entity, const Byte* data);
+        // Append entities that all start out with the same components, data holds one value per column or nullptr for the defaults
+        Index CreateEntities(std::span<const Entity> entities, const Byte* data);
         void CopyEntity(Index intoIndex, ArchetypeChunk& fromChunk, Index fromIndex);
         Entity& GetEntity(Index index);
         void RemoveLast();
+        inline void Clear() { m_Count = 0; }
 
         Byte* GetComponent(ComponentType type, Index index);
         Byte* GetComponent(Index archetypeComponentIndex, Index index);
@@ -79,16 +158,64 @@ namespace EVA::ECS
             }
         }
 
+        template <typename T> inline auto GetComponent(const Index index) -> optional_ref_transform_t<T>
+        {
+            return GetComponent<T>(m_ArchetypeInfo.GetComponentIndex(optional_inner_type_t<T>::GetType()), index);
+        }
+
+        // The whole column as a contiguous array, empty if the chunk does not have the component
+        template <typename T> inline std::span<T> GetColumn(std::optional<Index> archetypeComponentIndex)
+        {
+            if (!archetypeComponentIndex.has_value())
+                return {};
+            return std::span<T>(FromBytes<T>(&m_Data[m_ArchetypeInfo.componentInfo[archetypeComponentIndex.value()].start]), m_Count);
+        }
+
+        template <typename T> inline std::span<T> GetColumn() { return GetColumn<T>(m_ArchetypeInfo.GetComponentIndex(T::GetType())); }
+
+        // Copy an entity from a chunk of another archetype, data holds the added components or nullptr for the defaults
+        Index AddEntity(const ColumnMap& columns, const ArchetypeChunk& chunk, Index indexInChunk, const Byte* data);
+
+        // Copy count entities starting at first, data holds one value per added column or nullptr for the defaults
+        Index AddEntities(const ColumnMap& columns, const ArchetypeChunk& chunk, Index first, Index count, const Byte* data);
+
+        // Use the layout of another archetype with the same columns, see Archetype::TakeChunks
+        void Relink(const ArchetypeInfo& archetypeInfo);
+
+        // Single component shorthands for AddEntity, they build the ColumnMap on every call so the engine uses cached edges instead
         Index AddEntityAddComponent(ComponentType newType, const ArchetypeChunk& chunk, Index indexInChunk, const Byte* data);
         Index AddEntityRemoveComponent(ComponentType removeType, const ArchetypeChunk& chunk, Index indexInChunk);
 
         inline Index Count() const { return m_Count; }
         inline bool Empty() const { return m_Count == 0; }
         inline bool Full() const { return m_Count == m_ArchetypeInfo.entitiesPerChunk; }
+        inline Index Capacity() const { return m_ArchetypeInfo.entitiesPerChunk; }
+        inline const ArchetypeInfo& GetInfo() const { return m_ArchetypeInfo; }
+        inline const Byte* Data() const { return m_Data; }
+
+        // The version each column was last written with, tags have no column and no version
+        inline Version GetVersion(Index archetypeComponentIndex) const { return m_Versions[archetypeComponentIndex].load(std::memory_order_relaxed); }
+        inline void MarkChanged(Index archetypeComponentIndex, Version version)
+        {
+            m_Versions[archetypeComponentIndex].store(version, std::memory_order_relaxed);
+        }
+        void MarkChanged(ComponentType type);
+        void MarkAllChanged();
+
+        // Components without an enabled mask are always enabled
+        bool IsEnabled(Index archetypeComponentIndex, Index index) const;
+        void SetEnabled(Index archetypeComponentIndex, Index index, bool enabled);
+        inline const MaskWord* GetEnabledMask(std::uint16_t mask) const { return &m_EnabledMasks[mask * m_ArchetypeInfo.maskWords]; }
 
       private:
         ArchetypeInfo m_ArchetypeInfo;
         Index m_Count;
-        std::vector<Byte> m_Data;
+        Byte* m_Data;
+        std::unique_ptr<std::atomic<Version>[]> m_Versions; // One per column
+        std::unique_ptr<MaskWord[]> m_EnabledMasks;         // maskWords words per enableable component
+
+        void EnableAll(Index first, Index count);
+        // Enabled bits of the components both chunks have, the others start enabled
+        void CopyEnabled(Index intoIndex, const ArchetypeChunk& fromChunk, Index fromIndex);
     };
 } // namespace EVA::ECS
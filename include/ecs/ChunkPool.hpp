@@ -0,0 +1,62 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+
+#include "Core.hpp"
+
+namespace EVA::ECS
+{
+    /* Fixed-size block allocator for chunk data shared by all archetypes
+     *
+     * Requests are rounded up to a power of two size class. Each size class carves its blocks out of
+     * slabs of at least SlabSize bytes and keeps the unused ones in a free list, so chunks released by
+     * one archetype are handed out again to the next one that needs a chunk of the same size.
+     * Blocks are aligned to their size class and are not cleared.
+     */
+    class ChunkPool
+    {
+      public:
+        static constexpr size_t SlabSize     = 1024 * 1024;
+        static constexpr size_t MinBlockSize = CacheLineSize;
+
+        ChunkPool() = default;
+        ~ChunkPool();
+
+        ChunkPool(const ChunkPool&)            = delete;
+        ChunkPool& operator=(const ChunkPool&) = delete;
+
+        static ChunkPool& Global();
+
+        Byte* Allocate(size_t size, size_t alignment);
+        void Free(Byte* data, size_t size, size_t alignment);
+
+        // Return slabs where every block is free to the system
+        void Trim();
+
+        size_t SlabCount() const;
+        size_t FreeBlockCount() const;
+
+        static size_t BlockSize(size_t size, size_t alignment);
+
+      private:
+        struct Slab
+        {
+            Byte* data;
+            size_t size;
+            size_t blockSize;
+        };
+
+        struct SizeClass
+        {
+            std::vector<Byte*> freeBlocks;
+        };
+
+        mutable std::mutex m_Mutex;
+        std::vector<SizeClass> m_SizeClasses;
+        std::vector<Slab> m_Slabs;
+
+        void AddSlab(size_t sizeClass, size_t blockSize);
+        static void FreeSlab(const Slab& slab);
+    };
+} // namespace EVA::ECS
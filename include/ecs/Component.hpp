@@ -4,12 +4,17 @@
 #include "OptionalRef.hpp"
 
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
 #include <cstring>
+#include <limits>
 #include <map>
 #include <memory>
 #include <optional>
 #include <ostream>
 #include <set>
+#include <stdexcept>
 #include <type_traits>
 #include <vector>
 
@@ -59,6 +64,9 @@ namespace EVA::ECS
             const char* name;
             size_t id{ 0 };
             size_t size{ 0 };
+            size_t alignment{ 0 };
+            bool tag{ false };
+            bool enableable{ false };
             std::unique_ptr<std::vector<Byte>> defaultData = nullptr;
         };
 
@@ -72,9 +80,20 @@ namespace EVA::ECS
 
         inline static Byte* DefaultData(ComponentType type) { return s_Info[type.Get()].defaultData->data(); }
 
+        // Tags are empty types, they are part of an archetype's components but have no column
+        inline static bool IsTag(ComponentType type) { return s_Info[type.Get()].tag; }
+
+        /* Types with static constexpr bool Enableable = true can be disabled per entity without changing its archetype,
+         * see Engine::SetEnabled
+         */
+        inline static bool IsEnableable(ComponentType type) { return s_Info[type.Get()].enableable; }
+
         template <typename T> inline static ComponentType Add(const char* name)
         {
             ComponentType type = ComponentType(s_IdCounter++);
+            // The ComponentList bitset has no room for more types, writing past it would corrupt every list
+            if (type.Get() >= MaxComponents)
+                throw std::length_error("EVA ECS: more component types registered than EVA_ECS_MAX_COMPONENTS");
 
             if (type.Get() >= s_Info.size())
             {
@@ -82,7 +101,11 @@ namespace EVA::ECS
             }
             s_Info[type.Get()].name        = name;
             s_Info[type.Get()].id          = type.Get();
-            s_Info[type.Get()].size        = sizeof(T);
+            s_Info[type.Get()].size        = ComponentDataSize<T>;
+            s_Info[type.Get()].alignment   = alignof(T);
+            s_Info[type.Get()].tag         = std::is_empty_v<T>;
+            if constexpr (requires { T::Enableable; })
+                s_Info[type.Get()].enableable = T::Enableable;
             s_Info[type.Get()].defaultData = std::make_unique<std::vector<EVA::ECS::Byte>>(sizeof(T));
 
             auto* instance = new T();
@@ -93,14 +116,91 @@ namespace EVA::ECS
         }
     };
 
+    /* Set of component types stored as a fixed-width bitset
+     *
+     * Building a list never allocates, Contains and ContainsAny are a few word-wise AND operations and the
+     * hash is updated on every Add and Remove so map lookups do not rehash the types.
+     * Iteration yields the types in ascending order.
+     */
     class ComponentList
     {
-        std::set<ComponentType> m_Types;
+        using Word = std::uint64_t;
+
+        static constexpr size_t WordBits  = sizeof(Word) * 8;
+        static constexpr size_t WordCount = (MaxComponents + WordBits - 1) / WordBits;
+
+        std::array<Word, WordCount> m_Words{};
+        size_t m_Hash{ 0 };
+
+        static inline size_t TypeHash(ComponentType type)
+        {
+            // splitmix64 finalizer, the list hash is the xor of the hashes of its types
+            std::uint64_t x = type.Get() + 0x9e3779b97f4a7c15ull;
+            x               = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+            x               = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+            return static_cast<size_t>(x ^ (x >> 31));
+        }
+
+        static inline Word Bit(ComponentType type) { return Word{ 1 } << (type.Get() % WordBits); }
 
       public:
+        class Iterator
+        {
+            const ComponentList* m_List;
+            size_t m_Type;
+
+            void SkipToSet()
+            {
+                while (m_Type < WordCount * WordBits)
+                {
+                    const Word word = m_List->m_Words[m_Type / WordBits] >> (m_Type % WordBits);
+                    if (word != 0)
+                    {
+                        m_Type += static_cast<size_t>(std::countr_zero(word));
+                        return;
+                    }
+                    m_Type = (m_Type / WordBits + 1) * WordBits;
+                }
+            }
+
+          public:
+            using value_type        = ComponentType;
+            using difference_type   = std::ptrdiff_t;
+            using iterator_category = std::forward_iterator_tag;
+
+            Iterator(const ComponentList* list, size_t type) : m_List(list), m_Type(type) { SkipToSet(); }
+
+            inline ComponentType operator*() const { return ComponentType(m_Type); }
+
+            inline Iterator& operator++()
+            {
+                m_Type++;
+                SkipToSet();
+                return *this;
+            }
+
+            inline Iterator operator++(int)
+            {
+                Iterator temp(*this);
+                operator++();
+                return temp;
+            }
+
+            inline bool operator==(const Iterator& other) const { return m_Type == other.m_Type; }
+            inline bool operator!=(const Iterator& other) const { return m_Type != other.m_Type; }
+        };
+
         ComponentList() = default;
-        ComponentList(const std::initializer_list<ComponentType>& types) : m_Types(types) {}
-        explicit ComponentList(std::set<ComponentType>& types) : m_Types(std::move(types)) {}
+        ComponentList(const std::initializer_list<ComponentType>& types)
+        {
+            for (const auto type : types)
+                Add(type);
+        }
+        explicit ComponentList(std::set<ComponentType>& types)
+        {
+            for (const auto type : types)
+                Add(type);
+        }
 
         template <typename... T> static inline ComponentList Create()
         {
@@ -109,10 +209,14 @@ namespace EVA::ECS
             return cl;
         }
 
+        // Adding a type that is already in the list, or removing one that is not, leaves the list as it is
         ComponentList& Add(ComponentType type)
         {
-            ECS_ASSERT(std::find(m_Types.begin(), m_Types.end(), type) == m_Types.end());
-            m_Types.insert(type);
+            ECS_ASSERT(type.Get() < MaxComponents);
+            if (Contains(type))
+                return *this;
+            m_Words[type.Get() / WordBits] |= Bit(type);
+            m_Hash ^= TypeHash(type);
             return *this;
         }
 
@@ -120,48 +224,57 @@ namespace EVA::ECS
 
         ComponentList& Remove(ComponentType type)
         {
-            ECS_ASSERT(std::find(m_Types.begin(), m_Types.end(), type) != m_Types.end());
-            m_Types.erase(type);
+            if (!Contains(type))
+                return *this;
+            m_Words[type.Get() / WordBits] &= ~Bit(type);
+            m_Hash ^= TypeHash(type);
             return *this;
         }
 
         template <typename T> inline ComponentList& Remove() { return Remove(T::GetType()); }
 
-        inline bool operator==(const ComponentList& other) const { return m_Types == other.m_Types; }
+        inline bool operator==(const ComponentList& other) const { return m_Hash == other.m_Hash && m_Words == other.m_Words; }
         inline bool operator!=(const ComponentList& other) const { return !(*this == other); }
 
         bool Contains(const ComponentList& other) const
         {
-            for (const auto& i : other.m_Types)
+            for (size_t i = 0; i < WordCount; i++)
             {
-                if (std::find(m_Types.begin(), m_Types.end(), i) == m_Types.end())
-                {
+                if ((m_Words[i] & other.m_Words[i]) != other.m_Words[i])
                     return false;
-                }
             }
             return true;
         }
 
-        bool Contains(const ComponentType& type) const { return std::find(m_Types.begin(), m_Types.end(), type) != m_Types.end(); }
+        bool Contains(const ComponentType& type) const
+        {
+            return type.Get() < MaxComponents && (m_Words[type.Get() / WordBits] & Bit(type)) != 0;
+        }
 
         bool ContainsAny(const ComponentList& list) const
         {
-            for (const auto comp : list)
+            for (size_t i = 0; i < WordCount; i++)
             {
-                if (Contains(comp))
+                if ((m_Words[i] & list.m_Words[i]) != 0)
                     return true;
             }
             return false;
         }
 
-        inline size_t Count() const { return m_Types.size(); }
+        inline size_t Count() const
+        {
+            size_t count = 0;
+            for (const auto word : m_Words)
+                count += static_cast<size_t>(std::popcount(word));
+            return count;
+        }
+
+        inline size_t Hash() const { return m_Hash; }
 
-        inline const std::set<ComponentType>& GetTypes() const { return m_Types; }
+        std::set<ComponentType> GetTypes() const { return std::set<ComponentType>(begin(), end()); }
 
-        inline std::set<ComponentType>::iterator begin() { return m_Types.begin(); }
-        inline std::set<ComponentType>::iterator end() { return m_Types.end(); }
-        inline std::set<ComponentType>::const_iterator begin() const { return m_Types.begin(); }
-        inline std::set<ComponentType>::const_iterator end() const { return m_Types.end(); }
+        inline Iterator begin() const { return Iterator(this, 0); }
+        inline Iterator end() const { return Iterator(this, WordCount * WordBits); }
     };
 
     // is_std_optional_v
@@ -204,11 +317,34 @@ namespace EVA::ECS
 
     template <typename T> inline constexpr bool is_not_v = is_not<T>::value;
 
+    // Changed, requires T and skips chunks where it has not been written since the system last ran
+    template <typename T> struct Changed
+    {
+        using type = T;
+    };
+
+    template <typename T> struct is_changed : std::false_type
+    {
+    };
+
+    template <typename T> struct is_changed<Changed<T>> : std::true_type
+    {
+    };
+
+    template <typename T> inline constexpr bool is_changed_v = is_changed<T>::value;
+
+    // Types that only filter and are not part of what an iterator yields
+    template <typename T> struct is_filter_only : std::bool_constant<is_not_v<T> || is_changed_v<T>>
+    {
+    };
+
     template <template <typename> typename Pred, typename... Ts>
     using filter_tuple_t = decltype(std::tuple_cat(std::conditional_t<Pred<Ts>::value, std::tuple<>, std::tuple<Ts>>{}...));
 
     template <typename... Ts> using remove_nots_t = filter_tuple_t<is_not, Ts...>;
 
+    template <typename... Ts> using remove_filter_only_t = filter_tuple_t<is_filter_only, Ts...>;
+
     // Optional ref
     template <typename T> struct optional_ref_transform
     {
@@ -227,6 +363,8 @@ namespace EVA::ECS
         ComponentList compulsory;
         ComponentList optional;
         ComponentList excluded;
+        ComponentList changed; // Also compulsory
+        ComponentList written; // Compulsory and optional types accessed as non-const T, the others are only read
 
       public:
         ComponentFilter() = default;
@@ -258,18 +396,33 @@ namespace EVA::ECS
             return *this;
         }
 
+        ComponentFilter& AddChanged(ComponentType type)
+        {
+            compulsory.Add(type);
+            changed.Add(type);
+            return *this;
+        }
+
         template <typename T> ComponentFilter& Add()
         {
             if constexpr (is_std_optional_v<T>)
             {
+                if constexpr (!std::is_const_v<typename T::value_type>)
+                    written.Add(T::value_type::GetType());
                 return AddOptional(T::value_type::GetType());
             }
             else if constexpr (is_not_v<T>)
             {
                 return AddExcluded(T::type::GetType());
             }
+            else if constexpr (is_changed_v<T>)
+            {
+                return AddChanged(T::type::GetType());
+            }
             else
             {
+                if constexpr (!std::is_const_v<T>)
+                    written.Add(T::GetType());
                 return AddCompulsory(T::GetType());
             }
         }
@@ -277,12 +430,14 @@ namespace EVA::ECS
         ComponentFilter& RemoveCompulsory(ComponentType type)
         {
             compulsory.Remove(type);
+            written.Remove(type);
             return *this;
         }
 
         ComponentFilter& RemoveOptional(ComponentType type)
         {
             optional.Remove(type);
+            written.Remove(type);
             return *this;
         }
 
@@ -292,6 +447,13 @@ namespace EVA::ECS
             return *this;
         }
 
+        ComponentFilter& RemoveChanged(ComponentType type)
+        {
+            compulsory.Remove(type);
+            changed.Remove(type);
+            return *this;
+        }
+
         template <typename T> ComponentFilter& Remove()
         {
             if constexpr (is_std_optional_v<T>)
@@ -300,7 +462,11 @@ namespace EVA::ECS
             }
             else if constexpr (is_not_v<T>)
             {
-                return RemoveNot(T::type::GetType());
+                return RemoveExcluded(T::type::GetType());
+            }
+            else if constexpr (is_changed_v<T>)
+            {
+                return RemoveChanged(T::type::GetType());
             }
             else
             {
@@ -308,9 +474,10 @@ namespace EVA::ECS
             }
         }
 
+        // Access does not change which archetypes match, so written is not compared
         bool operator==(const ComponentFilter& other) const
         {
-            return compulsory == other.compulsory && optional == other.optional && excluded == other.excluded;
+            return compulsory == other.compulsory && optional == other.optional && excluded == other.excluded && changed == other.changed;
         }
         bool operator!=(const ComponentFilter& other) const { return !(*this == other); }
 
@@ -328,37 +495,94 @@ namespace EVA::ECS
 
         bool Contains(const ComponentType& type) const { return compulsory.Contains(type); }
 
+        // True if an archetype with these components is selected by the filter
+        bool Matches(const ComponentList& components) const { return components.Contains(compulsory) && !excluded.ContainsAny(components); }
+
         size_t Count() const { return compulsory.Count(); }
 
         const ComponentList& GetCompulsory() const { return compulsory; }
         const ComponentList& GetOptional() const { return optional; }
         const ComponentList& GetExcluded() const { return excluded; }
+        const ComponentList& GetChanged() const { return changed; }
+        const ComponentList& GetWritten() const { return written; }
     };
 
     struct Entity
     {
         EVA_ECS_REGISTER_COMPONENT(Entity);
 
-        EntityId id = 0;
-        Index index = 0;
+#ifdef EVA_ECS_COMPACT_ENTITY
+        EntityId id = 0; // Location index in the low bits, generation in the high bits
+
+        Entity() = default;
+        explicit Entity(EntityId id) : id(id) {}
+        Entity(EntityIndex index, EntityGeneration generation) : id((EntityId(generation) << EntityIndexBits) | index) {}
+
+        EntityIndex Index() const { return static_cast<EntityIndex>(id); }
+        EntityGeneration Generation() const { return static_cast<EntityGeneration>(id >> EntityIndexBits); }
+#else
+        EntityId id       = 0;
+        EntityIndex index = 0;
 
         Entity() = default;
         explicit Entity(EntityId id) : id(id) {}
-        Entity(EntityId id, Index index) : id(id), index(index) {}
+        Entity(EntityId id, EntityIndex index) : id(id), index(index) {}
+
+        EntityIndex Index() const { return index; }
+#endif
 
         bool operator==(const Entity& other) const { return id == other.id; }
         bool operator!=(const Entity& other) const { return !(*this == other); }
     };
 
+    // Where the entity with the same index is stored
     struct EntityLocation
     {
-        Index archetype, chunk, position;
-        EntityId entityId;
+#ifdef EVA_ECS_COMPACT_ENTITY
+        static constexpr unsigned ArchetypeBits = 16;
+        static constexpr unsigned PositionBits  = 16;
 
+        std::uint32_t archetype : ArchetypeBits = 0;
+        std::uint32_t position : PositionBits   = 0;
+        std::uint32_t chunk                     = 0;
+        EntityGeneration generation             = 0; // Of the entity stored here, or of the next one once released
+
+        EntityLocation() = default;
+        explicit EntityLocation(Index archetype, Index chunk, Index position, EntityId entityId)
+        : archetype(static_cast<std::uint32_t>(archetype)), position(static_cast<std::uint32_t>(position)),
+          chunk(static_cast<std::uint32_t>(chunk)), generation(Entity(entityId).Generation())
+        {
+            if (archetype >= (Index(1) << ArchetypeBits) || position >= (Index(1) << PositionBits) ||
+                chunk > std::numeric_limits<std::uint32_t>::max())
+            {
+                throw std::length_error("Entity location does not fit in EVA_ECS_COMPACT_ENTITY, too many archetypes or entities per chunk");
+            }
+        }
+
+        bool Holds(const Entity& entity) const { return entity.Generation() == generation; }
+
+        // Returns false once the generation is used up, the location must then not be reused
+        bool Release() { return ++generation != std::numeric_limits<EntityGeneration>::max(); }
+#else
+        static constexpr EntityId Released = std::numeric_limits<EntityId>::max();
+
+        EntityIndex archetype = 0, chunk = 0, position = 0;
+        EntityId entityId     = Released;
+
+        EntityLocation() = default;
         explicit EntityLocation(Index archetype, Index chunk, Index position, EntityId entityId)
         : archetype(archetype), chunk(chunk), position(position), entityId(entityId)
         {
         }
+
+        bool Holds(const Entity& entity) const { return entity.id == entityId; }
+
+        bool Release()
+        {
+            entityId = Released;
+            return true;
+        }
+#endif
     };
 } // namespace EVA::ECS
 
@@ -373,16 +597,7 @@ namespace std
     template <> struct hash<EVA::ECS::ComponentList>
     {
       public:
-        std::size_t operator()(const EVA::ECS::ComponentList& list) const
-        {
-            size_t value = 0;
-            for (const auto& type : list.GetTypes())
-            {
-                std::size_t h = std::hash<size_t>{}(type.Get());
-                value ^= h + 0x9e3779b9 + (value << 6) + (value >> 2);
-            }
-            return value;
-        }
+        std::size_t operator()(const EVA::ECS::ComponentList& list) const { return list.Hash(); }
     };
 
     template <> struct hash<EVA::ECS::ComponentFilter>
@@ -393,10 +608,12 @@ namespace std
             std::size_t h1 = std::hash<EVA::ECS::ComponentList>{}(filter.GetCompulsory());
             std::size_t h2 = std::hash<EVA::ECS::ComponentList>{}(filter.GetOptional());
             std::size_t h3 = std::hash<EVA::ECS::ComponentList>{}(filter.GetExcluded());
+            std::size_t h4 = std::hash<EVA::ECS::ComponentList>{}(filter.GetChanged());
 
             std::size_t value = h1;
             value ^= h2 + 0x9e3779b9 + (value << 6) + (value >> 2);
             value ^= h3 + 0x9e3779b9 + (value << 6) + (value >> 2);
+            value ^= h4 + 0x9e3779b9 + (value << 6) + (value >> 2);
             return value;
         }
     };
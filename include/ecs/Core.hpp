@@ -4,8 +4,10 @@
 #include <algorithm>
 #include <array>
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
 #include <functional>
+#include <type_traits>
 #include <vector>
 
 #ifdef ECS_DEBUG
@@ -29,15 +31,44 @@
 #define ECS_ASSERT(x)
 #endif // ECS_DEBUG
 
+// Upper bound on registered component types, sets the width of the ComponentList bitset
+#ifndef EVA_ECS_MAX_COMPONENTS
+#define EVA_ECS_MAX_COMPONENTS 256
+#endif
+
 namespace EVA::ECS
 {
-    using Index    = size_t;
-    using EntityId = size_t;
+    using Index = size_t;
+
+    /* With EVA_ECS_COMPACT_ENTITY the entity handle is a single 64-bit id and EntityLocation is packed into 12 bytes,
+     * halving Entity (the first column of every chunk) and the location table from 32 to 12 bytes per entity.
+     * The id holds the location index in the low 32 bits and a generation of that location in the high 32 bits.
+     * The generation is bumped every time an entity is destroyed, a location whose generation runs out is retired.
+     */
+#ifdef EVA_ECS_COMPACT_ENTITY
+    using EntityId         = std::uint64_t;
+    using EntityIndex      = std::uint32_t;
+    using EntityGeneration = std::uint32_t;
+
+    constexpr unsigned EntityIndexBits = 32;
+#else
+    using EntityId    = size_t;
+    using EntityIndex = size_t;
+#endif
 
     using Byte = unsigned char;
     static_assert(sizeof(Byte) == 1);
+
+    // 64 bits so that comparing versions never has to deal with the counter wrapping
+    using Version = std::uint64_t;
     constexpr size_t DefaultChunkSize        = 1024*128;
+    constexpr size_t MinChunkSize            = 1024*16;
     constexpr size_t DefaultCommandQueueSize = 1024*32;
+    constexpr size_t CacheLineSize           = 64;
+    constexpr size_t MaxComponents           = EVA_ECS_MAX_COMPONENTS;
+
+    // Round value up to the nearest multiple of alignment, which must be a power of two
+    inline constexpr size_t AlignUp(size_t value, size_t alignment) { return (value + alignment - 1) & ~(alignment - 1); }
 
     template <typename T> inline Byte* ToBytes(T& value) { return reinterpret_cast<Byte*>(&value); }
     template <typename T> inline Byte* ToBytes(T* value) { return reinterpret_cast<Byte*>(value); }
@@ -50,6 +81,9 @@ namespace EVA::ECS
 
     template <typename... T> inline constexpr size_t SizeOf = (sizeof(T) + ...);
 
+    // Empty component types (tags) take up no space in chunks or component data
+    template <typename T> inline constexpr size_t ComponentDataSize = std::is_empty_v<T> ? 0 : sizeof(T);
+
     template <typename T> T inline PostAdd(T& value, T diff)
     {
         T temp = value;
@@ -79,7 +113,7 @@ namespace EVA::ECS
             size_t type_id;
         };
 
-        auto entries = std::array<ItemEntry, sizeof...(T)>{ ItemEntry{ &items, sizeof(T), T::GetType().Get() }... };
+        auto entries = std::array<ItemEntry, sizeof...(T)>{ ItemEntry{ &items, ComponentDataSize<T>, T::GetType().Get() }... };
         std::sort(entries.begin(), entries.end(), [](auto const& a, auto const& b) { return a.type_id < b.type_id; });
 
         std::vector<Byte> data(SizeOf<T...>);
@@ -102,7 +136,7 @@ namespace EVA::ECS
             size_t type_id;
         };
 
-        auto entries = std::array<ItemEntry, sizeof...(T)>{ ItemEntry{ &items, sizeof(T), T::GetType().Get() }... };
+        auto entries = std::array<ItemEntry, sizeof...(T)>{ ItemEntry{ &items, ComponentDataSize<T>, T::GetType().Get() }... };
         std::sort(entries.begin(), entries.end(), [](auto const& a, auto const& b) { return a.type_id < b.type_id; });
 
         for (auto const& e : entries)
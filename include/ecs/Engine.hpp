@@ -1,5 +1,10 @@
 #pragma once
 
+#include <array>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <stack>
 #include <unordered_map>
@@ -12,11 +17,28 @@
 namespace EVA::ECS
 {
     class System;
+
+    enum class ComponentEvent
+    {
+        Add,    // The entity gained the component, including when it was created with it
+        Remove, // The entity lost the component, including when it was destroyed
+        Set     // The component was given a value by SetComponent or when added or created with a value
+    };
+
+    using ComponentObserver = std::function<void(std::span<const Entity>)>;
+
     class Engine
     {
       public:
         using ArchetypeMap = std::unordered_map<ComponentList, Index>;
 
+        // Archetypes matching a filter, kept up to date as new archetypes are created
+        struct Query
+        {
+            ComponentFilter filter;
+            std::vector<Index> archetypes;
+        };
+
         Engine();
 
         Entity CreateEntity();
@@ -25,8 +47,17 @@ namespace EVA::ECS
 
         template <typename... T> Entity CreateEntityFromComponents(const T&... components);
 
+        // Create count entities in one archetype, data holds the components every entity starts with or nullptr for the defaults
+        std::vector<Entity> CreateEntities(const ComponentList& components, Index count, const Byte* data = nullptr);
+        template <typename... T> std::vector<Entity> CreateEntitiesFromComponents(Index count, const T&... components);
+
         void DeleteEntity(const Entity& entity);
 
+        // Destroy every entity matched by the filter, whole archetypes are emptied at once
+        void DestroyEntities(const ComponentFilter& filter);
+        // Entities are removed from the back of each archetype first, so no destroyed entity is ever moved
+        void DestroyEntities(std::span<const Entity> entities);
+
         std::optional<Index> GetArchetypeIndex(const ComponentList& components) const;
         Archetype& GetArchetype(Index index);
 
@@ -34,6 +65,11 @@ namespace EVA::ECS
 
         std::vector<Archetype*> GetArchetypes(const ComponentList& components, bool allowEmpty = false);
         std::vector<Archetype*> GetArchetypes(const ComponentFilter& filter, bool allowEmpty = false);
+        // Fills archetypes in place, reusing its memory
+        void GetArchetypes(const ComponentFilter& filter, std::vector<Archetype*>& archetypes, bool allowEmpty = false);
+
+        // Registers the query on first use, later calls with the same filter return the same object
+        const Query& GetQuery(const ComponentFilter& filter);
 
         template <typename... T> inline EntityIterator<Entity, T...> GetEntityIterator();
 
@@ -49,14 +85,72 @@ namespace EVA::ECS
         template <typename T> void RemoveComponent(Entity& entity);
         void RemoveComponent(Entity& entity, const ComponentType type);
 
+        // Add and remove several components with a single move to the final archetype
+        template <typename... T> void AddComponents(Entity& entity);
+        template <typename... T> void AddComponents(Entity& entity, const T&... components);
+        template <typename... T> void RemoveComponents(Entity& entity);
+
+        /* data holds a value for every type in add ordered by ComponentType, or nullptr for the defaults
+         * Types the entity already has are set to their value, or left as they are without data
+         * Types the entity lacks in remove are ignored
+         */
+        void ChangeComponents(Entity& entity, const ComponentList& add, const ComponentList& remove, const Byte* data = nullptr);
+
+        /* Move every entity matched by the filter a chunk at a time, archetypes that already have (or lack) the type are skipped
+         * When only tags change and the target archetype is empty its chunks are swapped in without copying
+         */
+        void AddComponentToAll(const ComponentFilter& filter, const ComponentType type, const Byte* data = nullptr);
+        template <typename T> void AddComponentToAll(const ComponentFilter& filter);
+        template <typename T> void AddComponentToAll(const ComponentFilter& filter, const T& component);
+
+        void RemoveComponentFromAll(const ComponentFilter& filter, const ComponentType type);
+        template <typename T> void RemoveComponentFromAll(const ComponentFilter& filter);
+
+        // Assign the component and notify its Set observers, writes through GetComponent are not observed
+        template <typename T> void SetComponent(const Entity& entity, const T& component);
+        void SetComponent(const Entity& entity, const ComponentType type, const Byte* data);
+
+        /* Observers are called by FlushEntityEvents with the entities the event happened to since the last flush,
+         * once per archetype transition. Removed components and destroyed entities are already gone by then.
+         * Observers must not be added from inside an observer.
+         */
+        void Observe(const ComponentEvent event, const ComponentType type, ComponentObserver observer);
+        template <typename T> void OnAdd(ComponentObserver observer) { Observe(ComponentEvent::Add, T::GetType(), std::move(observer)); }
+        template <typename T> void OnRemove(ComponentObserver observer) { Observe(ComponentEvent::Remove, T::GetType(), std::move(observer)); }
+        template <typename T> void OnSet(ComponentObserver observer) { Observe(ComponentEvent::Set, T::GetType(), std::move(observer)); }
+
+        // Marks the component's column in the entity's chunk as changed, unless T is const
         template <typename T> T& GetComponent(const Entity& entity);
         template <typename T> OptionalRef<T> TryGetComponent(const Entity& entity);
         Byte* GetComponent(const Entity& entity, const ComponentType type);
 
+        /* Disabling an enableable component keeps it and its value on the entity without moving it to another archetype,
+         * iterators that yield the type skip the entity until it is enabled again. Components start out enabled.
+         */
+        template <typename T> void SetEnabled(const Entity& entity, const bool enabled) { SetEnabled(entity, T::GetType(), enabled); }
+        void SetEnabled(const Entity& entity, const ComponentType type, const bool enabled);
+        template <typename T> bool IsEnabled(const Entity& entity) { return IsEnabled(entity, T::GetType()); }
+        bool IsEnabled(const Entity& entity, const ComponentType type);
+
         template <typename T> T* AddSystem();
 
+        // Flushes the entity events first
         void UpdateSystems();
 
+        /* Update systems that do not conflict at the same time on JobSystem::Global()
+         * Conflicting systems keep the order they were added in, see System::Reads and System::Writes
+         */
+        void UpdateSystemsParallel();
+        const std::vector<std::vector<System*>>& GetSystemLevels();
+
+        /* Deliver the entities created and destroyed since the last flush to the subscribed systems, one span per archetype,
+         * and the component events to their observers
+         */
+        void FlushEntityEvents();
+
+        // Compact every archetype, release its empty chunks and return unused chunk memory to the system
+        void ShrinkToFit();
+
       private:
         Index m_EntityIdCounter;
         Index m_EntityCount;
@@ -67,10 +161,83 @@ namespace EVA::ECS
         ArchetypeMap m_ArchetypeMap;
         std::vector<Archetype> m_Archetypes;
 
+        std::mutex m_QueryMutex;
+        std::unordered_map<ComponentFilter, std::unique_ptr<Query>> m_Queries;
+
         std::vector<std::shared_ptr<System>> m_Systems;
+        std::vector<std::vector<System*>> m_SystemLevels; // Systems in a level do not conflict with each other
+        bool m_SystemLevelsDirty = true;
+
+        struct EntityEvent
+        {
+            Index archetype;
+            Index order; // Position in the queue, keeps the sort stable without a temporary buffer
+            Entity entity;
+        };
+
+        std::vector<System*> m_EventSystems; // Systems that called SubscribeToEntityEvents
+        std::vector<EntityEvent> m_CreatedEvents;
+        std::vector<EntityEvent> m_DestroyedEvents;
+        std::vector<EntityEvent> m_FlushEvents;
+        std::vector<Entity> m_FlushEntities;
+
+        static constexpr Index NoArchetype = std::numeric_limits<Index>::max(); // Before creation and after destruction
+
+        struct ComponentTransition
+        {
+            Index from;
+            Index to;
+            Index order; // Position in the queue, as for EntityEvent
+            Entity entity;
+            bool set; // The added components were given values
+        };
+
+        struct ComponentSet
+        {
+            ComponentType type;
+            Entity entity;
+        };
+
+        std::vector<std::array<std::vector<ComponentObserver>, 3>> m_Observers; // Indexed by type, then by ComponentEvent
+        ComponentList m_ObservedTypes;
+        std::vector<ComponentTransition> m_Transitions;
+        std::vector<ComponentTransition> m_FlushTransitions;
+        std::vector<ComponentSet> m_Sets;
+        std::vector<ComponentSet> m_FlushSets;
 
         Entity GetNextEntity();
 
+        void BuildSystemLevels();
+
+        inline void QueueEntityEvent(std::vector<EntityEvent>& events, Index archetype, const Entity& entity)
+        {
+            if (!m_EventSystems.empty())
+                events.emplace_back(archetype, events.size(), entity);
+        }
+        void FlushEntityEvents(std::vector<EntityEvent>& events, void (System::*callback)(std::span<const Entity>));
+
+        // Whether moving entities between the archetypes adds or removes an observed type, either one may be NoArchetype
+        inline bool IsObserved(const Index from, const Index to) const
+        {
+            if (m_ObservedTypes.Count() == 0)
+                return false;
+            return (from != NoArchetype && m_Archetypes[from].GetComponents().ContainsAny(m_ObservedTypes)) ||
+                   (to != NoArchetype && m_Archetypes[to].GetComponents().ContainsAny(m_ObservedTypes));
+        }
+        inline void QueueTransition(const Index from, const Index to, const Entity& entity, const bool set)
+        {
+            m_Transitions.emplace_back(from, to, m_Transitions.size(), entity, set);
+        }
+        void FlushComponentEvents();
+        void Notify(const ComponentEvent event, const ComponentType type, std::span<const Entity> entities);
+
+        // Cached transition from an archetype with type added or removed, created on first use
+        const Archetype::Edge& GetEdge(const Index archetypeIndex, const ComponentType type, const bool add);
+        // Cached transition from an archetype to the one with exactly the given components, created on first use
+        const Archetype::Edge& GetChangeEdge(const Index archetypeIndex, const ComponentList& types);
+        void MoveEntity(const Entity& entity, const Index archetype, const ColumnMap& columns, const Byte* data);
+        void MoveAllEntities(const ComponentFilter& filter, const ComponentType type, const bool add, const Byte* data);
+
         Archetype& CreateArchetype(const ComponentList& components);
         std::pair<Index, Archetype&> GetOrCreateArchetype(const ComponentList& components);
     };
@@ -86,6 +253,12 @@ namespace EVA::ECS
         return CreateEntity(ComponentList::Create<T...>(), &data[0]);
     }
 
+    template <typename... T> inline std::vector<Entity> Engine::CreateEntitiesFromComponents(Index count, const T&... components)
+    {
+        auto data = CombineBytesById(components...);
+        return CreateEntities(ComponentList::Create<T...>(), count, data.data());
+    }
+
     template <typename... T> inline std::vector<Archetype*> Engine::GetArchetypes(bool allowEmpty)
     {
         return GetArchetypes(ComponentFilter::Create<T...>(), allowEmpty);
@@ -100,17 +273,58 @@ namespace EVA::ECS
 
     template <typename T> inline void Engine::RemoveComponent(Entity& entity) { RemoveComponent(entity, T::GetType()); }
 
+    template <typename... T> inline void Engine::AddComponents(Entity& entity)
+    {
+        ChangeComponents(entity, ComponentList::Create<T...>(), ComponentList());
+    }
+
+    template <typename... T> inline void Engine::AddComponents(Entity& entity, const T&... components)
+    {
+        auto data = CombineBytesById(components...);
+        ChangeComponents(entity, ComponentList::Create<T...>(), ComponentList(), data.data());
+    }
+
+    template <typename... T> inline void Engine::RemoveComponents(Entity& entity)
+    {
+        ChangeComponents(entity, ComponentList(), ComponentList::Create<T...>());
+    }
+
+    template <typename T> inline void Engine::AddComponentToAll(const ComponentFilter& filter) { AddComponentToAll(filter, T::GetType()); }
+
+    template <typename T> inline void Engine::AddComponentToAll(const ComponentFilter& filter, const T& component)
+    {
+        AddComponentToAll(filter, T::GetType(), ToBytes(component));
+    }
+
+    template <typename T> inline void Engine::RemoveComponentFromAll(const ComponentFilter& filter)
+    {
+        RemoveComponentFromAll(filter, T::GetType());
+    }
+
+    template <typename T> inline void Engine::SetComponent(const Entity& entity, const T& component)
+    {
+        GetComponent<T>(entity) = component;
+        if (m_ObservedTypes.Contains(T::GetType()))
+        {
+            m_Sets.emplace_back(T::GetType(), entity);
+        }
+    }
+
     template <typename T> inline T& Engine::GetComponent(const Entity& entity)
     {
-        const auto& loc = m_EntityLocations[entity.index];
-        ECS_ASSERT(entity.id == loc.entityId);
+        const auto& loc = m_EntityLocations[entity.Index()];
+        ECS_ASSERT(loc.Holds(entity));
+        if constexpr (!std::is_const_v<T>)
+            GetArchetype(loc.archetype).m_Chunks[loc.chunk]->MarkChanged(T::GetType());
         return GetArchetype(loc.archetype).GetComponent<T>(loc.chunk, loc.position);
     }
 
     template <typename T> inline OptionalRef<T> Engine::TryGetComponent(const Entity& entity)
     {
-        const auto& loc = m_EntityLocations[entity.index];
-        ECS_ASSERT(entity.id == loc.entityId);
+        const auto& loc = m_EntityLocations[entity.Index()];
+        ECS_ASSERT(loc.Holds(entity));
+        if constexpr (!std::is_const_v<T>)
+            GetArchetype(loc.archetype).m_Chunks[loc.chunk]->MarkChanged(T::GetType());
         return GetArchetype(loc.archetype).TryGetComponent<T>(loc.chunk, loc.position);
     }
 
@@ -120,6 +334,12 @@ namespace EVA::ECS
         auto system      = (T*)m_Systems[m_Systems.size() - 1].get();
         system->m_Engine = this;
         system->Init();
+        m_SystemLevelsDirty = true;
+
+        if (system->m_EventFilter.has_value())
+        {
+            m_EventSystems.push_back(system);
+        }
         return system;
     }
 } // namespace EVA::ECS
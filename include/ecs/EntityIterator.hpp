@@ -1,6 +1,8 @@
 #pragma once
 
-#include <execution>
+#include <array>
+#include <bit>
+#include <span>
 #include <thread>
 #include <vector>
 
@@ -8,6 +10,7 @@
 #include "CommandQueue.hpp"
 #include "Component.hpp"
 #include "Core.hpp"
+#include "JobSystem.hpp"
 
 #ifndef EVA_ECS_PROFILE_FUNCTION
 #define EVA_ECS_PROFILE_FUNCTION()
@@ -33,10 +36,18 @@ namespace EVA::ECS
 
     using ArchetypeIterator = std::vector<Archetype*>::iterator;
 
+    // How EntityIterator::Split divides the entities between ranges
+    enum class SplitMode
+    {
+        Entities, // Equal entity counts, ranges may start and end inside a chunk
+        Chunks    // Whole chunks only, each range gets at least the target count unless it is the last one
+    };
+
     template <typename... T> class EntityIterator
     {
         using CompIndices = std::tuple<index_transform_t<T>...>;
         using value_type  = std::tuple<optional_ref_transform_t<T>...>;
+        using Masks       = std::array<std::uint16_t, sizeof...(T)>; // Enabled masks that have to be set for an entity to be iterated
 
         struct ChunkInfo
         {
@@ -45,99 +56,245 @@ namespace EVA::ECS
             Archetype* a;
             ArchetypeChunk* c;
             CompIndices comp_indices;
+            Index offset; // Index in the chunk of the entity at begin
         };
 
+      public:
+        class Iterator;
+
+      private:
         std::vector<ChunkInfo> m_Chunks;
         std::vector<Archetype*> m_Archetypes;
+        std::vector<std::pair<Iterator, Iterator>> m_Ranges; // Reused by Process
+
+        // Chunks are stored in order of their flat index range, so the one containing i is found by binary search
+        static const ChunkInfo* FindChunk(const std::vector<ChunkInfo>& chunks, Index i)
+        {
+            const auto it = std::upper_bound(chunks.begin(), chunks.end(), i, [](Index value, const ChunkInfo& info) { return value < info.end; });
+            return it == chunks.end() ? nullptr : &*it;
+        }
+
+        static bool ChangedSince(const ArchetypeChunk& chunk, const ComponentList& changed, Version since)
+        {
+            for (const auto type : changed)
+            {
+                const auto i = chunk.GetInfo().GetComponentIndex(type);
+                if (i.has_value() && i.value() < chunk.GetInfo().columnCount && chunk.GetVersion(i.value()) > since)
+                    return true;
+            }
+            return false;
+        }
+
+        template <typename U> static std::span<U> Slice(std::span<U> column, const ChunkInfo& info)
+        {
+            return column.empty() ? column : column.subspan(info.offset, info.end - info.begin);
+        }
+
+        // The enabled mask of U in the archetype, if U is yielded for every entity and is enableable
+        template <typename U> static void AddMask(const ArchetypeInfo& info, const CompIndices& comp_indices, Masks& masks, size_t& maskCount)
+        {
+            if constexpr (!is_std_optional_v<U>)
+            {
+                const auto i = std::get<index_transform_t<U>>(comp_indices).index;
+                if (i.has_value() && info.componentInfo[i.value()].mask != ComponentInfo::NoMask)
+                {
+                    masks[maskCount++] = info.componentInfo[i.value()].mask;
+                }
+            }
+        }
+
+        /* Call add(first, last) for each run of entities that have every mask enabled
+         * The masks are combined and scanned a word at a time, so long runs of enabled or disabled entities cost one step per word
+         */
+        template <typename Func>
+        static void ForEachEnabledRun(const ArchetypeChunk& chunk, const Masks& masks, size_t maskCount, Func&& add)
+        {
+            using Word          = ArchetypeChunk::MaskWord;
+            constexpr auto Bits = ArchetypeChunk::MaskWordBits;
+            const Index count   = chunk.Count();
+            const Index words   = (count + Bits - 1) / Bits;
+
+            bool inRun     = false;
+            Index runBegin = 0;
+            for (Index w = 0; w < words; w++)
+            {
+                Word word = ~Word{ 0 };
+                for (size_t m = 0; m < maskCount; m++)
+                {
+                    word &= chunk.GetEnabledMask(masks[m])[w];
+                }
+                if (w == words - 1 && count % Bits != 0)
+                {
+                    word &= (Word{ 1 } << (count % Bits)) - 1;
+                }
+
+                // Look for the next set bit outside of a run and the next clear bit inside one
+                for (Index bit = 0; bit < Bits;)
+                {
+                    const Word rest = (inRun ? ~word : word) >> bit;
+                    if (rest == 0)
+                        break;
+
+                    bit += static_cast<Index>(std::countr_zero(rest));
+                    if (inRun)
+                        add(runBegin, w * Bits + bit);
+                    else
+                        runBegin = w * Bits + bit;
+                    inRun = !inRun;
+                }
+            }
+            if (inRun)
+            {
+                add(runBegin, count);
+            }
+        }
+
+        template <typename U> static void MarkWritten(ArchetypeChunk& chunk, const CompIndices& comp_indices, Version version)
+        {
+            using Inner = optional_inner_type_t<U>;
+            if constexpr (!std::is_const_v<Inner> && !std::is_same_v<Inner, Entity>)
+            {
+                if (const auto i = std::get<index_transform_t<U>>(comp_indices).index; i.has_value() && i.value() < chunk.GetInfo().columnCount)
+                {
+                    chunk.MarkChanged(i.value(), version);
+                }
+            }
+        }
 
       public:
-        explicit EntityIterator(const std::vector<Archetype*>& archetypes) : m_Archetypes(archetypes)
+        EntityIterator() = default;
+        explicit EntityIterator(const std::vector<Archetype*>& archetypes) { Assign(archetypes); }
+
+        // Iterate another set of archetypes, keeping the memory used for the previous one
+        void Assign(const std::vector<Archetype*>& archetypes) { Assign(archetypes, ChangeVersion::Current()); }
+
+        /* The columns of every T that is not const are stamped with version in every chunk that is iterated
+         * If changed is not empty only chunks where one of those columns was written after since are iterated
+         * Entities where a yielded enableable component is disabled are skipped, std::optional<T> does not skip
+         */
+        void Assign(const std::vector<Archetype*>& archetypes, [[maybe_unused]] Version version, const ComponentList& changed = ComponentList(), Version since = 0)
         {
+            m_Archetypes = archetypes;
+            m_Chunks.clear();
+
             Index count = 0;
             CompIndices comp_indices;
+            const bool filterChanged = changed.Count() > 0;
+            Masks masks;
 
             for (auto a : m_Archetypes)
             {
                 ((std::get<index_transform_t<T>>(comp_indices).index = a->GetInfo().GetComponentIndex(optional_inner_type_t<T>::GetType())), ...);
 
-                for (auto c : a->m_Chunks)
+                size_t maskCount = 0;
+                (AddMask<T>(a->GetInfo(), comp_indices, masks, maskCount), ...);
+
+                for (auto& c : a->m_Chunks)
                 {
                     if (c->Empty())
                         break;
 
-                    Index begin = count;
-                    count += c->Count();
+                    if (filterChanged && !ChangedSince(*c, changed, since))
+                        continue;
+
+                    const auto add = [&](Index first, Index last)
+                    {
+                        Index begin = count;
+                        count += last - first;
+                        m_Chunks.emplace_back(begin, count, a, c.get(), comp_indices, first);
+                    };
 
-                    m_Chunks.emplace_back(begin, count, a, c.get(), comp_indices);
+                    if (maskCount == 0)
+                    {
+                        add(0, c->Count());
+                    }
+                    else
+                    {
+                        ForEachEnabledRun(*c, masks, maskCount, add);
+                    }
+                    (MarkWritten<T>(*c, comp_indices, version), ...);
                 }
             }
         }
 
         Index ArchetypeCount() { return m_Archetypes.size(); }
-        Index Count() const
-        {
-            Index count = 0;
-            for (auto& a : m_Archetypes)
-            {
-                count += a->EntityCount();
-            }
-            return count;
-        }
+        Index Count() const { return m_Chunks.empty() ? 0 : m_Chunks.back().end; }
+        bool Empty() const { return m_Chunks.empty(); }
 
-        bool Empty() const
+        value_type operator[](Index i) const
         {
-            for (auto& a : m_Archetypes)
-            {
-                if (a->EntityCount() > 0)
-                    return false;
-            }
-            return true;
+            const ChunkInfo* ci = FindChunk(m_Chunks, i);
+
+            const Index index_in_chunk = i - ci->begin + ci->offset;
+            return value_type(ci->c->template GetComponent<T>(std::get<index_transform_t<T>>(ci->comp_indices).index, index_in_chunk)...);
         }
 
-        value_type operator[](Index i) const
+        /* Call func once per chunk with a std::span over the column of each component
+         * Optional components get an empty span for chunks that do not have them
+         * Chunks with disabled components are passed as one call per run of enabled entities
+         */
+        template <typename Func> void ForEachChunk(Func&& func)
         {
-            const ChunkInfo* ci = nullptr;
             for (const ChunkInfo& info : m_Chunks)
             {
-                if (info.end > i)
-                {
-                    ci = &info;
-                    break;
-                }
+                func(Slice(info.c->template GetColumn<optional_inner_type_t<T>>(std::get<index_transform_t<T>>(info.comp_indices).index), info)...);
             }
-
-            const Index index_in_chunk = i - ci->begin;
-            return value_type(ci->c->GetComponent<T>(std::get<index_transform_t<T>>(ci->comp_indices).index, index_in_chunk)...);
         }
 
-
-        class Iterator;
         Iterator begin() { return Iterator(0, m_Chunks); }
         Iterator end() { return Iterator(Count(), m_Chunks); }
 
-        auto Split(size_t num_chunks)
+        auto Split(size_t num_chunks, SplitMode mode = SplitMode::Entities)
         {
             std::vector<std::pair<Iterator, Iterator>> iterators;
+            Split(num_chunks, mode, iterators);
+            return iterators;
+        }
+
+        void Split(size_t num_chunks, SplitMode mode, std::vector<std::pair<Iterator, Iterator>>& iterators)
+        {
+            iterators.clear();
             size_t n          = Count();
             size_t chunk_size = (n + num_chunks - 1) / num_chunks;
 
+            if (mode == SplitMode::Chunks)
+            {
+                // A chunk with disabled entities has one ChunkInfo per enabled run, only cut after its last one
+                Index begin = 0;
+                for (Index i = 0; i < m_Chunks.size(); i++)
+                {
+                    const ChunkInfo& info = m_Chunks[i];
+                    const bool chunkEnds  = i + 1 == m_Chunks.size() || m_Chunks[i + 1].c != info.c;
+                    if (chunkEnds && info.end - begin >= chunk_size)
+                    {
+                        iterators.emplace_back(Iterator(begin, m_Chunks), Iterator(info.end, m_Chunks));
+                        begin = info.end;
+                    }
+                }
+                if (begin < n)
+                {
+                    iterators.emplace_back(Iterator(begin, m_Chunks), Iterator(n, m_Chunks));
+                }
+                return;
+            }
+
             for (size_t i = 0; i < n; i += chunk_size)
             {
                 auto b = Iterator(i, m_Chunks);
                 auto e = Iterator(i + std::min(chunk_size, n - i), m_Chunks);
                 iterators.emplace_back(b, e);
             }
-
-            return iterators;
         }
 
-        template <typename Func> void Process(size_t num_chunks, Func&& func)
+        template <typename Func> void Process(size_t num_chunks, Func&& func, SplitMode mode = SplitMode::Entities)
         {
-            auto iterators = Split(num_chunks);
-            std::for_each(std::execution::par_unseq, iterators.begin(), iterators.end(),
-            [&](auto& range)
+            auto& iterators = m_Ranges;
+            Split(num_chunks, mode, iterators);
+            JobSystem::Global().ParallelFor(iterators.size(),
+            [&](size_t idx)
             {
                 EVA_ECS_PROFILE_SCOPE("Parallel");
+                auto& range = iterators[idx];
                 for (auto it = range.first; it != range.second; ++it)
                 {
                     func(*it);
@@ -145,16 +302,16 @@ namespace EVA::ECS
             });
         }
 
-        template <typename Func> void ProcessWithCQ(size_t num_chunks, Engine& engine, Func&& func)
+        template <typename Func> void ProcessWithCQ(size_t num_chunks, Engine& engine, Func&& func, SplitMode mode = SplitMode::Entities)
         {
-            auto iterators = Split(num_chunks);
+            auto iterators = Split(num_chunks, mode);
             std::vector<CommandQueue> queues(iterators.size());
 
-            std::for_each(std::execution::par_unseq, iterators.begin(), iterators.end(),
-            [&](auto& range)
+            JobSystem::Global().ParallelFor(iterators.size(),
+            [&](size_t idx)
             {
                 EVA_ECS_PROFILE_SCOPE("Parallel");
-                size_t idx = &range - &iterators[0];
+                auto& range = iterators[idx];
 
                 CommandQueue cq;
                 for (auto it = range.first; it != range.second; ++it)
@@ -177,23 +334,12 @@ namespace EVA::ECS
         {
             Index m_Index;
             const ChunkInfo* m_CI;
-            const std::vector<ChunkInfo>& m_Chunks;
+            const std::vector<ChunkInfo>* m_Chunks;
 
           public:
             const Index& Pos() { return m_Index; }
 
-            void UpdateCI()
-            {
-                m_CI = nullptr;
-                for (const ChunkInfo& info : m_Chunks)
-                {
-                    if (info.end > m_Index)
-                    {
-                        m_CI = &info;
-                        break;
-                    }
-                }
-            }
+            void UpdateCI() { m_CI = FindChunk(*m_Chunks, m_Index); }
 
             using value_type        = std::tuple<optional_ref_transform_t<T>...>;
             using pointer           = value_type*;
@@ -201,7 +347,7 @@ namespace EVA::ECS
             using difference_type   = Index;
             using iterator_category = std::bidirectional_iterator_tag;
 
-            Iterator(Index index, const std::vector<ChunkInfo>& chunks) : m_Index(index), m_Chunks(chunks) { UpdateCI(); }
+            Iterator(Index index, const std::vector<ChunkInfo>& chunks) : m_Index(index), m_Chunks(&chunks) { UpdateCI(); }
 
             inline bool operator==(const Iterator& other) const { return m_Index == other.m_Index; }
             inline bool operator!=(const Iterator& other) const { return m_Index != other.m_Index; }
@@ -259,15 +405,15 @@ namespace EVA::ECS
                 return *this;
             }
 
-            inline Iterator operator+(difference_type n) const { return Iterator(m_Index + n, m_Chunks); }
-            inline Iterator operator-(difference_type n) const { return Iterator(m_Index - n, m_Chunks); }
+            inline Iterator operator+(difference_type n) const { return Iterator(m_Index + n, *m_Chunks); }
+            inline Iterator operator-(difference_type n) const { return Iterator(m_Index - n, *m_Chunks); }
 
             inline difference_type operator-(const Iterator& other) const { return m_Index - other.m_Index; }
 
             inline EntityIterator::value_type operator*() const
             {
-                const Index index_in_chunk = m_Index - m_CI->begin;
-                return value_type(m_CI->c->GetComponent<T>(std::get<index_transform_t<T>>(m_CI->comp_indices).index, index_in_chunk)...);
+                const Index index_in_chunk = m_Index - m_CI->begin + m_CI->offset;
+                return value_type(m_CI->c->template GetComponent<T>(std::get<index_transform_t<T>>(m_CI->comp_indices).index, index_in_chunk)...);
             }
         };
     };
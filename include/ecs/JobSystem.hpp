@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Core.hpp"
+
+namespace EVA::ECS
+{
+    /* Work-stealing thread pool used for the parallel parts of the library
+     *
+     * The worker count includes the calling thread, so a pool of N runs N - 1 persistent threads and the
+     * thread calling ParallelFor helps out until its jobs are done. Jobs are dealt out round-robin to the
+     * per-worker deques, a worker takes from the back of its own deque and steals from the front of the
+     * others when it runs dry. With a worker count of 1 every job runs on the calling thread in index order.
+     */
+    class JobSystem
+    {
+      public:
+        explicit JobSystem(size_t workerCount = DefaultWorkerCount());
+        ~JobSystem();
+
+        JobSystem(const JobSystem&)            = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+
+        static JobSystem& Global();
+        static size_t DefaultWorkerCount();
+
+        // Stops and restarts the threads, must not be called while jobs are running
+        void SetWorkerCount(size_t workerCount);
+        inline size_t WorkerCount() const { return m_Workers.size() + 1; }
+
+        // Run func(i) for every i in [0, count) and return when all of them are done
+        template <typename Func> void ParallelFor(size_t count, Func&& func);
+
+      private:
+        struct Job
+        {
+            void (*function)(void* context, size_t index);
+            void* context;
+            size_t index;
+            std::atomic<size_t>* remaining;
+        };
+
+        // Jobs in [head, jobs.size()), the vector is cleared once it runs empty so its memory is reused
+        struct Queue
+        {
+            std::mutex mutex;
+            std::vector<Job> jobs;
+            size_t head = 0;
+        };
+
+        std::vector<std::thread> m_Workers;
+        std::vector<std::unique_ptr<Queue>> m_Queues; // One per worker thread plus one for outside callers
+        std::atomic<size_t> m_QueuedCount{ 0 };
+        std::atomic<size_t> m_NextQueue{ 0 };
+
+        std::mutex m_WakeMutex;
+        std::condition_variable m_WakeCondition;
+        bool m_Stop = false;
+
+        void Start(size_t workerCount);
+        void Stop();
+        void WorkerLoop(size_t queueIndex);
+
+        void Push(const Job& job);
+        bool TryPop(size_t queueIndex, Job& job);
+        bool TryRunJob(size_t queueIndex);
+        size_t CurrentQueue() const;
+
+        void Run(size_t count, void (*function)(void*, size_t), void* context);
+    };
+
+    template <typename Func> void JobSystem::ParallelFor(size_t count, Func&& func)
+    {
+        auto call = [](void* context, size_t index) { (*static_cast<std::remove_reference_t<Func>*>(context))(index); };
+        Run(count, call, const_cast<void*>(static_cast<const void*>(std::addressof(func))));
+    }
+} // namespace EVA::ECS
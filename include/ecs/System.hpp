@@ -1,5 +1,9 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <optional>
+
 #include "Component.hpp"
 #include "Core.hpp"
 #include "EntityIterator.hpp"
@@ -19,34 +23,175 @@ namespace EVA::ECS
         virtual inline void OnEntityCreated(Entity e) {}
         virtual inline void OnEntityDestroyed(Entity e) {}
 
+        /* Entity events are only sent to systems that call SubscribeToEntityEvents. They are queued and delivered
+         * by Engine::FlushEntityEvents, which runs at the start of every update, as one span per archetype.
+         * Destroyed entities are already gone when the event arrives.
+         * The defaults call OnEntityCreated and OnEntityDestroyed for each entity.
+         */
+        virtual inline void OnEntitiesCreated(std::span<const Entity> entities)
+        {
+            for (const auto& e : entities)
+                OnEntityCreated(e);
+        }
+
+        virtual inline void OnEntitiesDestroyed(std::span<const Entity> entities)
+        {
+            for (const auto& e : entities)
+                OnEntityDestroyed(e);
+        }
+
+        const ComponentList& GetReads() const { return m_Reads; }
+        const ComponentList& GetWrites() const { return m_Writes; }
+        bool HasDeclaredAccess() const { return m_DeclaredAccess; }
+
+        // Systems that have not declared their access conflict with every other system
+        bool ConflictsWith(const System& other) const;
+
       protected:
         Engine& GetEngine();
 
-        template <typename Tuple, typename F, typename... Extra> decltype(auto) unpack_tuple_types(F&& f, Extra&&... extra)
+        /* Declare the components Update reads or writes, called from Init
+         * Accepts the same types as GetEntityIterator, std::optional<T> and Changed<T> declare T and Not<T> declares nothing
+         * A type that is only read must be iterated as const T
+         * Systems run by Engine::UpdateSystemsParallel must declare everything they touch and must not
+         * create or destroy entities or change their components outside of a CommandQueue
+         */
+        template <typename... T> void Reads()
         {
-            return []<typename... Ts>(std::tuple<Ts...>*, F&& fn, Extra&&... xs)
-            { return std::forward<F>(fn).template operator()<Ts...>(std::forward<Extra>(xs)...); }(
-            (Tuple*)nullptr, std::forward<F>(f), std::forward<Extra>(extra)...);
+            m_DeclaredAccess = true;
+            (DeclareAccess<T>(m_Reads), ...);
         }
 
-        struct Builder
+        template <typename... T> void Writes()
         {
-            template <typename... Ts> auto operator()(const std::vector<Archetype*>& a) const { return EntityIterator<Entity, Ts...>(a); }
-        };
+            m_DeclaredAccess = true;
+            (DeclareAccess<T>(m_Writes), ...);
+        }
+
+        // Receive events for entities in archetypes matching the filter, called from Init
+        template <typename... T> void SubscribeToEntityEvents() { m_EventFilter = ComponentFilter::Create<T...>(); }
 
+        /* Yields const T& for const T, which only counts as reading T and does not mark it as changed
+         * Changed<T> requires T and skips chunks where it has not been written since the last time the engine updated this system.
+         * Iterating a type marks its column as written in every chunk, the system does not see its own writes.
+         */
         template <typename... T> auto GetEntityIterator()
         {
-            const auto filter     = ComponentFilter::Create<T...>();
-            const auto archetypes = GetArchetypes(filter);
+            using Iterator = typename entity_iterator_from_tuple<remove_filter_only_t<T...>>::type;
 
-            using Cleaned = remove_nots_t<T...>;
+            auto& query = GetQuery<Iterator, T...>();
+            GetArchetypes(query.filter, query.archetypes);
 
-            return unpack_tuple_types<Cleaned>(Builder{}, archetypes);
+            Iterator iterator;
+            iterator.Assign(query.archetypes, CurrentVersion(), query.filter.GetChanged(), m_LastVersion);
+            return iterator;
+        }
+
+        /* Same as GetEntityIterator, but the iterator is owned by the system and rebuilt in place on every call with
+         * the same types, so once its buffers have grown a query does not allocate.
+         * The reference stays valid for the lifetime of the system, but a nested call with the same types reassigns it.
+         * Nested loops over the same types have to use GetEntityIterator.
+         */
+        template <typename... T> auto& GetCachedEntityIterator()
+        {
+            using Iterator = typename entity_iterator_from_tuple<remove_filter_only_t<T...>>::type;
+
+            auto& query = GetQuery<Iterator, T...>();
+            ECS_ASSERT(!query.iterating);
+            GetArchetypes(query.filter, query.archetypes);
+            query.iterator.Assign(query.archetypes, CurrentVersion(), query.filter.GetChanged(), m_LastVersion);
+            return query.iterator;
+        }
+
+        // The callback gets a std::span<Entity> followed by one span per component that is not Not<> or Changed<>
+        template <typename... T, typename Func> void ForEachChunk(Func&& func)
+        {
+            using Iterator = typename entity_iterator_from_tuple<remove_filter_only_t<T...>>::type;
+
+            auto& iterator = GetCachedEntityIterator<T...>();
+            auto& query    = GetQuery<Iterator, T...>();
+            query.iterating = true;
+            iterator.ForEachChunk(std::forward<Func>(func));
+            query.iterating = false;
         }
 
       private:
-        std::vector<Archetype*> GetArchetypes(const ComponentFilter& filter);
+        template <typename Tuple> struct entity_iterator_from_tuple;
+        template <typename... Ts> struct entity_iterator_from_tuple<std::tuple<Ts...>>
+        {
+            using type = EntityIterator<Entity, Ts...>;
+        };
+
+        struct CachedQueryBase
+        {
+            virtual ~CachedQueryBase() = default;
+        };
+
+        template <typename Iterator> struct CachedQuery : CachedQueryBase
+        {
+            ComponentFilter filter;
+            std::vector<Archetype*> archetypes;
+            Iterator iterator;
+            bool iterating = false; // Set while ForEachChunk runs, the iterator must not be reassigned
+
+            explicit CachedQuery(const ComponentFilter& filter) : filter(filter) {}
+        };
+
+        // Every distinct type list passed to GetEntityIterator or GetCachedEntityIterator gets its own slot in m_Queries
+        inline static std::atomic<size_t> s_QueryIdCounter{ 0 };
+        template <typename... T> static size_t QueryId()
+        {
+            static const size_t id = s_QueryIdCounter++;
+            return id;
+        }
+
+        template <typename Iterator, typename... T> CachedQuery<Iterator>& GetQuery()
+        {
+            const auto id = QueryId<T...>();
+            if (id >= m_Queries.size())
+            {
+                m_Queries.resize(id + 1);
+            }
+            if (m_Queries[id] == nullptr)
+            {
+                m_Queries[id] = std::make_unique<CachedQuery<Iterator>>(ComponentFilter::Create<T...>());
+
+                // Types only declared as read have to be iterated as const T
+                ECS_ASSERT(!m_DeclaredAccess || m_Writes.Contains(static_cast<CachedQuery<Iterator>&>(*m_Queries[id]).filter.GetWritten()));
+            }
+            return static_cast<CachedQuery<Iterator>&>(*m_Queries[id]);
+        }
+
+        Version CurrentVersion() const { return m_Version != 0 ? m_Version : ChangeVersion::Current(); }
+
+        void GetArchetypes(const ComponentFilter& filter, std::vector<Archetype*>& archetypes);
+
+        // Called by the engine, takes a new change version for the update
+        void RunUpdate();
+
+        template <typename T> static void DeclareAccess(ComponentList& list)
+        {
+            if constexpr (is_changed_v<T>)
+            {
+                DeclareAccess<typename T::type>(list);
+            }
+            else if constexpr (!is_not_v<T>)
+            {
+                if (!list.Contains(optional_inner_type_t<T>::GetType()))
+                    list.Add(optional_inner_type_t<T>::GetType());
+            }
+        }
 
         Engine* m_Engine = nullptr;
+        std::vector<std::unique_ptr<CachedQueryBase>> m_Queries;
+
+        ComponentList m_Reads;
+        ComponentList m_Writes;
+        bool m_DeclaredAccess = false;
+
+        std::optional<ComponentFilter> m_EventFilter;
+
+        Version m_Version     = 0; // Set while the engine runs Update
+        Version m_LastVersion = 0; // The version of the last update, writes with a newer one have not been seen
     };
 } // namespace EVA::ECS
@@ -2,9 +2,11 @@
 
 #include "Archetype.hpp"
 #include "ArchetypeChunk.hpp"
+#include "ChunkPool.hpp"
 #include "CommandQueue.hpp"
 #include "Component.hpp"
 #include "Core.hpp"
 #include "Engine.hpp"
 #include "EntityIterator.hpp"
+#include "JobSystem.hpp"
 #include "System.hpp"
@@ -5,15 +5,62 @@ namespace EVA::ECS
     Archetype::Archetype(const ComponentList& components, size_t chunkSize)
     : m_Components(components), m_ArchetypeInfo(components, chunkSize), m_EntityCount(0), m_ActiveChunkIndex(0)
     {
+        for (size_t size = MinChunkSize; size < chunkSize; size *= 2)
+        {
+            auto info = m_ArchetypeInfo.WithChunkSize(size);
+            if (info.entitiesPerChunk > 0)
+            {
+                m_GrowthInfos.push_back(std::move(info));
+            }
+        }
+
         AddChunk();
     }
 
     void Archetype::AddChunk()
     {
-        m_Chunks.push_back(std::make_shared<ArchetypeChunk>(m_ArchetypeInfo));
+        m_Chunks.push_back(std::make_shared<ArchetypeChunk>(GetChunkInfo(m_Chunks.size())));
         m_ActiveChunkIndex = m_Chunks.size() - 1;
     }
 
+    const ArchetypeInfo& Archetype::GetChunkInfo(Index chunk) const
+    {
+        return chunk < m_GrowthInfos.size() ? m_GrowthInfos[chunk] : m_ArchetypeInfo;
+    }
+
+    void Archetype::TakeChunks(Archetype& other)
+    {
+        ECS_ASSERT(m_EntityCount == 0);
+        ECS_ASSERT(m_ArchetypeInfo.columnCount == other.m_ArchetypeInfo.columnCount);
+
+        std::swap(m_Chunks, other.m_Chunks);
+        std::swap(m_ActiveChunkIndex, other.m_ActiveChunkIndex);
+        std::swap(m_EntityCount, other.m_EntityCount);
+
+        for (Index i = 0; i < m_Chunks.size(); i++)
+        {
+            m_Chunks[i]->Relink(GetChunkInfo(i));
+        }
+        for (Index i = 0; i < other.m_Chunks.size(); i++)
+        {
+            other.m_Chunks[i]->Relink(other.GetChunkInfo(i));
+        }
+    }
+
+    std::pair<Index, Index> Archetype::GetChunkPosition(Index index) const
+    {
+        Index chunk = 0;
+        for (const auto& info : m_GrowthInfos)
+        {
+            if (index < info.entitiesPerChunk)
+                return std::make_pair(chunk, index);
+
+            index -= info.entitiesPerChunk;
+            chunk++;
+        }
+        return std::make_pair(chunk + index / m_ArchetypeInfo.entitiesPerChunk, index % m_ArchetypeInfo.entitiesPerChunk);
+    }
+
     void Archetype::ReserveChunk()
     {
         if (m_Chunks[m_ActiveChunkIndex]->Full())
@@ -59,12 +106,36 @@ namespace EVA::ECS
         if (m_Chunks[m_ActiveChunkIndex]->Empty() && m_ActiveChunkIndex != 0)
         {
             --m_ActiveChunkIndex;
+            ReleaseSpareChunks();
         }
 
         m_EntityCount--;
         return entity;
     }
 
+    void Archetype::Clear()
+    {
+        for (Index i = 0; i <= ActiveChunkIndex(); i++)
+        {
+            m_Chunks[i]->Clear();
+        }
+        m_ActiveChunkIndex = 0;
+        m_EntityCount      = 0;
+        ReleaseSpareChunks();
+    }
+
+    void Archetype::ReleaseSpareChunks()
+    {
+        // Only trim once there are clearly more spares than needed, and then only down to half of that,
+        // so an archetype oscillating around a chunk boundary does not allocate and release every time
+        const Index used     = m_ActiveChunkIndex + 1;
+        const Index maxSpare = std::max(MinSpareChunks, used / 2);
+        if (m_Chunks.size() - used > maxSpare)
+        {
+            m_Chunks.resize(used + std::max(MinSpareChunks, maxSpare / 2));
+        }
+    }
+
     Entity& Archetype::GetEntity(const Index chunk, const Index indexInChunk)
     {
         ECS_ASSERT(m_EntityCount > 0);
@@ -78,6 +149,16 @@ namespace EVA::ECS
         return m_Chunks[chunk]->GetComponent(archetypeComponentIndex, indexInChunk);
     }
 
+    std::pair<Index, Index>
+    Archetype::AddEntity(Archetype& otherArchetype, const Index otherChunk, const Index otherIndexInChunk, const ColumnMap& columns, const Byte* data)
+    {
+        ReserveChunk();
+        m_EntityCount++;
+
+        auto indexInChunk = m_Chunks[m_ActiveChunkIndex]->AddEntity(columns, *otherArchetype.m_Chunks[otherChunk], otherIndexInChunk, data);
+        return std::make_pair(ActiveChunkIndex(), indexInChunk);
+    }
+
     std::pair<Index, Index>
     Archetype::AddEntityAddComponent(Archetype& otherArchetype, const Index otherChunk, const Index otherIndexInChunk, const ComponentType newType, const Byte* data)
     {
@@ -99,6 +180,24 @@ namespace EVA::ECS
         return std::make_pair(ActiveChunkIndex(), indexInChunk);
     }
 
+    Archetype::Edge& Archetype::GetAddEdge(const ComponentType type)
+    {
+        if (type.Get() >= m_AddEdges.size())
+        {
+            m_AddEdges.resize(type.Get() + 1);
+        }
+        return m_AddEdges[type.Get()];
+    }
+
+    Archetype::Edge& Archetype::GetRemoveEdge(const ComponentType type)
+    {
+        if (type.Get() >= m_RemoveEdges.size())
+        {
+            m_RemoveEdges.resize(type.Get() + 1);
+        }
+        return m_RemoveEdges[type.Get()];
+    }
+
     Byte* Archetype::GetComponent(const ComponentType type, const Index chunk, const Index indexInChunk)
     {
         ECS_ASSERT(chunk <= ActiveChunkIndex());
@@ -107,16 +206,14 @@ namespace EVA::ECS
 
     Byte* Archetype::GetComponent(const Index archetypeComponentIndex, const Index index)
     {
-        Index chunkIndex   = index / m_ArchetypeInfo.entitiesPerChunk;
-        Index indexInChunk = index % m_ArchetypeInfo.entitiesPerChunk;
+        const auto [chunkIndex, indexInChunk] = GetChunkPosition(index);
         ECS_ASSERT(chunkIndex <= ActiveChunkIndex());
         return m_Chunks[chunkIndex]->GetComponent(archetypeComponentIndex, indexInChunk);
     }
 
     Byte* Archetype::GetComponent(const ComponentType type, const Index index)
     {
-        Index chunkIndex   = index / m_ArchetypeInfo.entitiesPerChunk;
-        Index indexInChunk = index % m_ArchetypeInfo.entitiesPerChunk;
+        const auto [chunkIndex, indexInChunk] = GetChunkPosition(index);
         ECS_ASSERT(chunkIndex <= ActiveChunkIndex());
         return m_Chunks[chunkIndex]->GetComponent(type, indexInChunk);
     }
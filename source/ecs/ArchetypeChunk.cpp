@@ -1,4 +1,5 @@
 #include "ArchetypeChunk.hpp"
+#include "ChunkPool.hpp"
 
 #include <cstring>
 
@@ -8,48 +9,153 @@ namespace EVA::ECS
 
     ArchetypeInfo::ArchetypeInfo(const ComponentList& componentList, size_t _chunkSize) : chunkSize(_chunkSize)
     {
-        componentInfo.resize(componentList.Count() + 1); // +1 for the required entity component
+        componentInfo.reserve(componentList.Count() + 1); // +1 for the required entity component
 
-        componentInfo[0].type = Entity::GetType();
-        componentInfo[0].size = sizeof(Entity);
-        entitySize            = sizeof(Entity);
+        componentInfo.push_back({ Entity::GetType(), sizeof(Entity), std::max(CacheLineSize, alignof(Entity)) });
+        entitySize = sizeof(Entity);
 
-        size_t i = 1;
         for (const auto& t : componentList)
         {
-            componentInfo[i].type = t;
-            componentInfo[i].size = ComponentMap::s_Info[t.Get()].size;
-            entitySize += componentInfo[i].size;
-            i++;
+            const auto& info = ComponentMap::s_Info[t.Get()];
+            if (!info.tag)
+            {
+                componentInfo.push_back({ t, info.size, std::max(CacheLineSize, info.alignment) });
+                entitySize += info.size;
+            }
+        }
+        columnCount = componentInfo.size();
+
+        for (const auto& t : componentList)
+        {
+            if (ComponentMap::IsTag(t))
+            {
+                componentInfo.push_back({ t, 0, 1 });
+            }
+        }
+
+        ECS_ASSERT(componentInfo.size() < NoComponent);
+        for (Index i = 0; i < componentInfo.size(); i++)
+        {
+            const auto type = componentInfo[i].type.Get();
+            if (type >= componentIndices.size())
+            {
+                componentIndices.resize(type + 1, NoComponent);
+            }
+            componentIndices[type] = static_cast<std::uint16_t>(i);
+
+            if (ComponentMap::IsEnableable(componentInfo[i].type))
+            {
+                componentInfo[i].mask = static_cast<std::uint16_t>(enableable.Count());
+                enableable.Add(componentInfo[i].type);
+            }
+        }
+
+        UpdateLayout();
+    }
+
+    void ArchetypeInfo::UpdateLayout()
+    {
+        alignment = CacheLineSize;
+        for (Index i = 0; i < columnCount; i++)
+        {
+            alignment = std::max(alignment, componentInfo[i].alignment);
         }
 
+        // Padding between the columns may push the last ones past the end of the chunk
         entitiesPerChunk = chunkSize / entitySize;
+        while (entitiesPerChunk > 0 && DataSize(entitiesPerChunk) > chunkSize)
+        {
+            entitiesPerChunk--;
+        }
+
+        size_t offset = 0;
+        for (Index i = 0; i < columnCount; i++)
+        {
+            auto& c = componentInfo[i];
+            c.start = AlignUp(offset, c.alignment);
+            offset  = c.start + c.size * entitiesPerChunk;
+        }
+
+        maskWords = (entitiesPerChunk + ArchetypeChunk::MaskWordBits - 1) / ArchetypeChunk::MaskWordBits;
+    }
 
+    size_t ArchetypeInfo::DataSize(const Index entityCount) const
+    {
         size_t offset = 0;
-        for (auto& c : componentInfo)
+        for (Index i = 0; i < columnCount; i++)
         {
-            c.start = offset;
-            offset += c.size * entitiesPerChunk;
+            offset = AlignUp(offset, componentInfo[i].alignment) + componentInfo[i].size * entityCount;
         }
+        return offset;
+    }
+
+    ArchetypeInfo ArchetypeInfo::WithChunkSize(const size_t _chunkSize) const
+    {
+        ArchetypeInfo info = *this;
+        info.chunkSize     = _chunkSize;
+        info.UpdateLayout();
+        return info;
+    }
+
+    size_t ArchetypeInfo::ChunkSizeFor(const ComponentList& componentList, const Index entityCount)
+    {
+        return ArchetypeInfo(componentList, 0).DataSize(entityCount);
     }
 
-    std::optional<Index> ArchetypeInfo::GetComponentIndex(const ComponentType type) const
+    namespace
     {
-        const auto it = std::find_if(componentInfo.begin(), componentInfo.end(), ComponentInfo::Predicate(type));
-        if (it == componentInfo.end())
-            return std::nullopt;
+        // Copy the first value, then keep doubling the filled part
+        void FillColumn(Byte* column, const Byte* value, size_t size, size_t count)
+        {
+            if (count == 0)
+                return;
 
-        return static_cast<Index>(std::distance(componentInfo.begin(), it));
+            std::memcpy(column, value, size);
+            for (size_t filled = 1; filled < count;)
+            {
+                const auto n = std::min(filled, count - filled);
+                std::memcpy(&column[filled * size], column, n * size);
+                filled += n;
+            }
+        }
+    } // namespace
+
+    // ColumnMap
+
+    ColumnMap ColumnMap::Create(const ArchetypeInfo& from, const ArchetypeInfo& to)
+    {
+        ColumnMap map;
+        for (Index i = 0; i < to.columnCount; i++)
+        {
+            const auto fromIndex = from.GetComponentIndex(to.componentInfo[i].type);
+            if (fromIndex.has_value())
+            {
+                map.copy.emplace_back(fromIndex.value(), i);
+            }
+            else
+            {
+                map.added.push_back(i);
+            }
+        }
+        return map;
     }
 
     // ArchetypeChunk
 
     ArchetypeChunk::ArchetypeChunk(ArchetypeInfo archetypeInfo)
-    : m_ArchetypeInfo(std::move(archetypeInfo)), m_Count(0), m_Data(m_ArchetypeInfo.chunkSize)
+    : m_ArchetypeInfo(std::move(archetypeInfo)), m_Count(0),
+      m_Data(ChunkPool::Global().Allocate(m_ArchetypeInfo.chunkSize, m_ArchetypeInfo.alignment)),
+      m_Versions(std::make_unique<std::atomic<Version>[]>(m_ArchetypeInfo.columnCount))
     {
+        if (m_ArchetypeInfo.enableable.Count() > 0)
+        {
+            m_EnabledMasks = std::make_unique<MaskWord[]>(m_ArchetypeInfo.enableable.Count() * m_ArchetypeInfo.maskWords);
+        }
         ECS_ASSERT(memset(&m_Data[0], 0, m_ArchetypeInfo.chunkSize) != nullptr);
     }
 
+    ArchetypeChunk::~ArchetypeChunk() { ChunkPool::Global().Free(m_Data, m_ArchetypeInfo.chunkSize, m_ArchetypeInfo.alignment); }
+
     Index ArchetypeChunk::CreateEntity(const Entity& entity)
     {
         ECS_ASSERT(m_Count < m_ArchetypeInfo.entitiesPerChunk);
@@ -58,12 +164,14 @@ namespace EVA::ECS
         std::memmove(&m_Data[m_Count * sizeof(Entity)], &entity, sizeof(Entity));
 
         // Starting at 1 to skip Entity
-        for (size_t i = 1; i < m_ArchetypeInfo.componentInfo.size(); i++)
+        for (size_t i = 1; i < m_ArchetypeInfo.columnCount; i++)
         {
             const auto& c = m_ArchetypeInfo.componentInfo[i];
             std::memmove(&m_Data[c.start + m_Count * c.size], ComponentMap::DefaultData(c.type), c.size);
         }
 
+        EnableAll(m_Count, 1);
+        MarkAllChanged();
         m_Count++;
         return m_Count - 1;
     }
@@ -77,24 +185,56 @@ namespace EVA::ECS
 
         // Starting at 1 to skip Entity
         Index dataIndex = 0;
-        for (size_t i = 1; i < m_ArchetypeInfo.componentInfo.size(); i++)
+        for (size_t i = 1; i < m_ArchetypeInfo.columnCount; i++)
         {
             const auto& c = m_ArchetypeInfo.componentInfo[i];
             std::memmove(&m_Data[c.start + m_Count * c.size], &data[dataIndex], c.size);
             dataIndex += c.size;
         }
 
+        EnableAll(m_Count, 1);
+        MarkAllChanged();
         m_Count++;
         return m_Count - 1;
     }
 
+    Index ArchetypeChunk::CreateEntities(std::span<const Entity> entities, const Byte* data)
+    {
+        const auto count = entities.size();
+        ECS_ASSERT(m_Count + count <= m_ArchetypeInfo.entitiesPerChunk);
+
+        std::memcpy(&m_Data[m_Count * sizeof(Entity)], entities.data(), count * sizeof(Entity));
+
+        // Starting at 1 to skip Entity
+        Index dataIndex = 0;
+        for (size_t i = 1; i < m_ArchetypeInfo.columnCount; i++)
+        {
+            const auto& c = m_ArchetypeInfo.componentInfo[i];
+            Byte* column  = &m_Data[c.start + m_Count * c.size];
+
+            FillColumn(column, data == nullptr ? ComponentMap::DefaultData(c.type) : &data[dataIndex], c.size, count);
+            dataIndex += c.size;
+        }
+
+        EnableAll(m_Count, count);
+        MarkAllChanged();
+        const auto first = m_Count;
+        m_Count += count;
+        return first;
+    }
+
     void ArchetypeChunk::CopyEntity(Index intoIndex, ArchetypeChunk& fromChunk, Index fromIndex)
     {
         ECS_ASSERT(intoIndex < m_ArchetypeInfo.entitiesPerChunk);
-        for (const auto& c : m_ArchetypeInfo.componentInfo)
+        for (size_t i = 0; i < m_ArchetypeInfo.columnCount; i++)
         {
-            std::memmove(&m_Data[c.start + intoIndex * c.size], &fromChunk.m_Data[c.start + fromIndex * c.size], c.size);
+            // The chunks may have different sizes, and therefore different column starts
+            const auto& c    = m_ArchetypeInfo.componentInfo[i];
+            const auto start = fromChunk.m_ArchetypeInfo.componentInfo[i].start;
+            std::memmove(&m_Data[c.start + intoIndex * c.size], &fromChunk.m_Data[start + fromIndex * c.size], c.size);
         }
+        CopyEnabled(intoIndex, fromChunk, fromIndex);
+        MarkAllChanged();
     }
 
     Entity& ArchetypeChunk::GetEntity(const Index index)
@@ -116,53 +256,80 @@ namespace EVA::ECS
         index * m_ArchetypeInfo.componentInfo[archetypeComponentIndex].size];
     }
 
-    Index ArchetypeChunk::AddEntityAddComponent(ComponentType newType, const ArchetypeChunk& chunk, Index indexInChunk, const Byte* data)
+    Index ArchetypeChunk::AddEntity(const ColumnMap& columns, const ArchetypeChunk& chunk, Index indexInChunk, const Byte* data)
     {
         ECS_ASSERT(m_Count < m_ArchetypeInfo.entitiesPerChunk);
 
-        size_t offset = 0;
-        for (size_t i = 0; i < m_ArchetypeInfo.componentInfo.size(); i++)
+        for (const auto& [from, to] : columns.copy)
         {
-            const auto& comp = m_ArchetypeInfo.componentInfo[i];
-            const auto size  = comp.size;
-            if (comp.type == newType)
-            {
-                std::memmove(&m_Data[comp.start + m_Count * size], data, size);
-                offset--;
-            }
-            else
-            {
-                ECS_ASSERT(comp.type == chunk.m_ArchetypeInfo.componentInfo[i + offset].type);
-                std::memmove(&m_Data[comp.start + m_Count * size],
-                &chunk.m_Data[chunk.m_ArchetypeInfo.componentInfo[i + offset].start + indexInChunk * size], size);
-            }
+            const auto& fromComp = chunk.m_ArchetypeInfo.componentInfo[from];
+            const auto& toComp   = m_ArchetypeInfo.componentInfo[to];
+            std::memcpy(&m_Data[toComp.start + m_Count * toComp.size], &chunk.m_Data[fromComp.start + indexInChunk * fromComp.size], toComp.size);
         }
 
+        Index dataIndex = 0;
+        for (const auto to : columns.added)
+        {
+            const auto& c = m_ArchetypeInfo.componentInfo[to];
+            std::memcpy(&m_Data[c.start + m_Count * c.size], data == nullptr ? ComponentMap::DefaultData(c.type) : &data[dataIndex], c.size);
+            dataIndex += c.size;
+        }
+
+        CopyEnabled(m_Count, chunk, indexInChunk);
+        MarkAllChanged();
         return m_Count++;
     }
 
-    Index ArchetypeChunk::AddEntityRemoveComponent(ComponentType removeType, const ArchetypeChunk& chunk, Index indexInChunk)
+    Index ArchetypeChunk::AddEntities(const ColumnMap& columns, const ArchetypeChunk& chunk, Index first, Index count, const Byte* data)
     {
-        ECS_ASSERT(m_Count < m_ArchetypeInfo.entitiesPerChunk);
+        ECS_ASSERT(m_Count + count <= m_ArchetypeInfo.entitiesPerChunk);
+        ECS_ASSERT(first + count <= chunk.m_Count);
 
-        size_t offset = 0;
-        for (size_t i = 0; i < chunk.m_ArchetypeInfo.componentInfo.size(); i++)
+        for (const auto& [from, to] : columns.copy)
         {
-            const auto& comp = chunk.m_ArchetypeInfo.componentInfo[i];
-            const auto size  = comp.size;
-            if (comp.type == removeType)
-            {
-                offset--;
-            }
-            else
-            {
-                ECS_ASSERT(m_ArchetypeInfo.componentInfo[i + offset].type == comp.type);
-                std::memmove(&m_Data[m_ArchetypeInfo.componentInfo[i + offset].start + m_Count * size],
-                &chunk.m_Data[comp.start + indexInChunk * size], size);
-            }
+            const auto& fromComp = chunk.m_ArchetypeInfo.componentInfo[from];
+            const auto& toComp   = m_ArchetypeInfo.componentInfo[to];
+            std::memcpy(&m_Data[toComp.start + m_Count * toComp.size], &chunk.m_Data[fromComp.start + first * fromComp.size], count * toComp.size);
         }
 
-        return m_Count++;
+        Index dataIndex = 0;
+        for (const auto to : columns.added)
+        {
+            const auto& c = m_ArchetypeInfo.componentInfo[to];
+            Byte* column  = &m_Data[c.start + m_Count * c.size];
+
+            FillColumn(column, data == nullptr ? ComponentMap::DefaultData(c.type) : &data[dataIndex], c.size, count);
+            dataIndex += c.size;
+        }
+
+        for (Index i = 0; i < count; i++)
+        {
+            CopyEnabled(m_Count + i, chunk, first + i);
+        }
+        MarkAllChanged();
+        const auto index = m_Count;
+        m_Count += count;
+        return index;
+    }
+
+    void ArchetypeChunk::Relink(const ArchetypeInfo& archetypeInfo)
+    {
+        ECS_ASSERT(archetypeInfo.chunkSize == m_ArchetypeInfo.chunkSize);
+        ECS_ASSERT(archetypeInfo.columnCount == m_ArchetypeInfo.columnCount);
+        ECS_ASSERT(archetypeInfo.enableable == m_ArchetypeInfo.enableable);
+        m_ArchetypeInfo = archetypeInfo;
+    }
+
+    Index ArchetypeChunk::AddEntityAddComponent(ComponentType newType, const ArchetypeChunk& chunk, Index indexInChunk, const Byte* data)
+    {
+        ECS_ASSERT(!chunk.m_ArchetypeInfo.GetComponentIndex(newType).has_value());
+        return AddEntity(ColumnMap::Create(chunk.m_ArchetypeInfo, m_ArchetypeInfo), chunk, indexInChunk, data);
+    }
+
+    Index ArchetypeChunk::AddEntityRemoveComponent(ComponentType removeType, const ArchetypeChunk& chunk, Index indexInChunk)
+    {
+        ECS_ASSERT(!m_ArchetypeInfo.GetComponentIndex(removeType).has_value());
+        return AddEntity(ColumnMap::Create(chunk.m_ArchetypeInfo, m_ArchetypeInfo), chunk, indexInChunk, nullptr);
     }
 
     Byte* ArchetypeChunk::GetComponent(const ComponentType type, const Index index)
@@ -173,4 +340,73 @@ namespace EVA::ECS
         return &m_Data[m_ArchetypeInfo.componentInfo[i.value()].start + index * m_ArchetypeInfo.componentInfo[i.value()].size];
     }
 
+    void ArchetypeChunk::MarkChanged(const ComponentType type)
+    {
+        const auto i = m_ArchetypeInfo.GetComponentIndex(type);
+        if (i.has_value() && i.value() < m_ArchetypeInfo.columnCount)
+        {
+            MarkChanged(i.value(), ChangeVersion::Current());
+        }
+    }
+
+    bool ArchetypeChunk::IsEnabled(const Index archetypeComponentIndex, const Index index) const
+    {
+        ECS_ASSERT(index < m_Count);
+        const auto mask = m_ArchetypeInfo.componentInfo[archetypeComponentIndex].mask;
+        if (mask == ComponentInfo::NoMask)
+            return true;
+        return (GetEnabledMask(mask)[index / MaskWordBits] >> (index % MaskWordBits)) & 1;
+    }
+
+    void ArchetypeChunk::SetEnabled(const Index archetypeComponentIndex, const Index index, const bool enabled)
+    {
+        ECS_ASSERT(index < m_Count);
+        const auto mask = m_ArchetypeInfo.componentInfo[archetypeComponentIndex].mask;
+        ECS_ASSERT(mask != ComponentInfo::NoMask);
+
+        auto& word     = m_EnabledMasks[mask * m_ArchetypeInfo.maskWords + index / MaskWordBits];
+        const auto bit = MaskWord{ 1 } << (index % MaskWordBits);
+        word           = enabled ? word | bit : word & ~bit;
+    }
+
+    void ArchetypeChunk::EnableAll(const Index first, const Index count)
+    {
+        for (size_t mask = 0; mask < m_ArchetypeInfo.enableable.Count(); mask++)
+        {
+            auto* words = &m_EnabledMasks[mask * m_ArchetypeInfo.maskWords];
+            for (Index i = first; i < first + count; i++)
+            {
+                words[i / MaskWordBits] |= MaskWord{ 1 } << (i % MaskWordBits);
+            }
+        }
+    }
+
+    void ArchetypeChunk::CopyEnabled(const Index intoIndex, const ArchetypeChunk& fromChunk, const Index fromIndex)
+    {
+        if (m_EnabledMasks == nullptr)
+            return;
+
+        for (const auto& c : m_ArchetypeInfo.componentInfo)
+        {
+            if (c.mask == ComponentInfo::NoMask)
+                continue;
+
+            const auto from    = fromChunk.m_ArchetypeInfo.GetComponentIndex(c.type);
+            const bool enabled = !from.has_value() || fromChunk.IsEnabled(from.value(), fromIndex);
+
+            auto& word     = m_EnabledMasks[c.mask * m_ArchetypeInfo.maskWords + intoIndex / MaskWordBits];
+            const auto bit = MaskWord{ 1 } << (intoIndex % MaskWordBits);
+            word           = enabled ? word | bit : word & ~bit;
+        }
+    }
+
+    void ArchetypeChunk::MarkAllChanged()
+    {
+        const auto version = ChangeVersion::Current();
+        for (size_t i = 0; i < m_ArchetypeInfo.columnCount; i++)
+        {
+            MarkChanged(i, version);
+        }
+    }
+
 } // namespace EVA::ECS
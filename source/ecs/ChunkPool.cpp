@@ -0,0 +1,119 @@
+#include "ChunkPool.hpp"
+
+#include <bit>
+#include <new>
+
+namespace EVA::ECS
+{
+    ChunkPool::~ChunkPool()
+    {
+        for (const auto& slab : m_Slabs)
+        {
+            FreeSlab(slab);
+        }
+    }
+
+    ChunkPool& ChunkPool::Global()
+    {
+        // Never destroyed, chunks owned by static objects may be released after other statics are gone
+        static auto* pool = new ChunkPool();
+        return *pool;
+    }
+
+    size_t ChunkPool::BlockSize(const size_t size, const size_t alignment)
+    {
+        return std::bit_ceil(std::max({ size, alignment, MinBlockSize }));
+    }
+
+    Byte* ChunkPool::Allocate(const size_t size, const size_t alignment)
+    {
+        const auto blockSize = BlockSize(size, alignment);
+        const auto sizeClass = static_cast<size_t>(std::countr_zero(blockSize));
+
+        std::lock_guard lock(m_Mutex);
+
+        if (sizeClass >= m_SizeClasses.size())
+        {
+            m_SizeClasses.resize(sizeClass + 1);
+        }
+
+        auto& freeBlocks = m_SizeClasses[sizeClass].freeBlocks;
+        if (freeBlocks.empty())
+        {
+            AddSlab(sizeClass, blockSize);
+        }
+
+        Byte* data = freeBlocks.back();
+        freeBlocks.pop_back();
+        return data;
+    }
+
+    void ChunkPool::Free(Byte* data, const size_t size, const size_t alignment)
+    {
+        if (data == nullptr)
+            return;
+
+        const auto sizeClass = static_cast<size_t>(std::countr_zero(BlockSize(size, alignment)));
+
+        std::lock_guard lock(m_Mutex);
+        ECS_ASSERT(sizeClass < m_SizeClasses.size());
+        m_SizeClasses[sizeClass].freeBlocks.push_back(data);
+    }
+
+    void ChunkPool::Trim()
+    {
+        std::lock_guard lock(m_Mutex);
+
+        std::vector<Slab> keep;
+        for (const auto& slab : m_Slabs)
+        {
+            auto& freeBlocks     = m_SizeClasses[static_cast<size_t>(std::countr_zero(slab.blockSize))].freeBlocks;
+            const auto inSlab    = [&](const Byte* b) { return b >= slab.data && b < slab.data + slab.size; };
+            const auto freeCount = static_cast<size_t>(std::count_if(freeBlocks.begin(), freeBlocks.end(), inSlab));
+
+            if (freeCount == slab.size / slab.blockSize)
+            {
+                freeBlocks.erase(std::remove_if(freeBlocks.begin(), freeBlocks.end(), inSlab), freeBlocks.end());
+                FreeSlab(slab);
+            }
+            else
+            {
+                keep.push_back(slab);
+            }
+        }
+        m_Slabs = std::move(keep);
+    }
+
+    size_t ChunkPool::SlabCount() const
+    {
+        std::lock_guard lock(m_Mutex);
+        return m_Slabs.size();
+    }
+
+    size_t ChunkPool::FreeBlockCount() const
+    {
+        std::lock_guard lock(m_Mutex);
+        size_t count = 0;
+        for (const auto& sizeClass : m_SizeClasses)
+        {
+            count += sizeClass.freeBlocks.size();
+        }
+        return count;
+    }
+
+    void ChunkPool::AddSlab(const size_t sizeClass, const size_t blockSize)
+    {
+        const auto slabSize = std::max(SlabSize, blockSize);
+        auto* data          = static_cast<Byte*>(::operator new(slabSize, std::align_val_t(blockSize)));
+        m_Slabs.push_back({ data, slabSize, blockSize });
+
+        // Push in reverse so blocks are handed out in address order
+        auto& freeBlocks = m_SizeClasses[sizeClass].freeBlocks;
+        for (size_t offset = slabSize; offset > 0; offset -= blockSize)
+        {
+            freeBlocks.push_back(data + offset - blockSize);
+        }
+    }
+
+    void ChunkPool::FreeSlab(const Slab& slab) { ::operator delete(slab.data, std::align_val_t(slab.blockSize)); }
+} // namespace EVA::ECS
@@ -1,4 +1,8 @@
 #include "Engine.hpp"
+#include "ChunkPool.hpp"
+#include "JobSystem.hpp"
+
+#include <tuple>
 
 namespace EVA::ECS
 {
@@ -12,50 +16,143 @@ namespace EVA::ECS
     {
         auto [archetypeIndex, archetype] = GetOrCreateArchetype(components);
 
-        size_t index = m_EntityLocations.size();
-        if (!m_FreeEntetyLocationIndices.empty())
-        {
-            index = m_FreeEntetyLocationIndices.top();
-            m_FreeEntetyLocationIndices.pop();
-        }
-
         auto entity            = GetNextEntity();
-        entity.index           = index;
         auto [chunk, position] = data == nullptr ? archetype.CreateEntity(entity) : archetype.CreateEntity(entity, data);
 
-        if (index == m_EntityLocations.size())
+        m_EntityLocations[entity.Index()] = EntityLocation(archetypeIndex, chunk, position, entity.id);
+
+        QueueEntityEvent(m_CreatedEvents, archetypeIndex, entity);
+        if (IsObserved(NoArchetype, archetypeIndex))
         {
-            m_EntityLocations.emplace_back(EntityLocation(archetypeIndex, chunk, position, entity.id));
+            QueueTransition(NoArchetype, archetypeIndex, entity, data != nullptr);
         }
-        else
+
+        return entity;
+    }
+
+    std::vector<Entity> Engine::CreateEntities(const ComponentList& components, const Index count, const Byte* data)
+    {
+        auto [archetypeIndex, archetype] = GetOrCreateArchetype(components);
+
+        std::vector<Entity> entities(count);
+        m_EntityLocations.reserve(m_EntityLocations.size() + count - std::min(count, m_FreeEntetyLocationIndices.size()));
+        for (auto& entity : entities)
         {
-            m_EntityLocations[index] = EntityLocation(archetypeIndex, chunk, position, entity.id);
+            entity = GetNextEntity();
         }
 
-        for (auto system : m_Systems)
+        archetype.CreateEntities(entities, data,
+        [&](Index chunk, Index first, std::span<const Entity> created)
         {
-            system->OnEntityCreated(entity);
+            for (Index i = 0; i < created.size(); i++)
+            {
+                m_EntityLocations[created[i].Index()] = EntityLocation(archetypeIndex, chunk, first + i, created[i].id);
+            }
+        });
+
+        const bool observed = IsObserved(NoArchetype, archetypeIndex);
+        for (const auto& entity : entities)
+        {
+            QueueEntityEvent(m_CreatedEvents, archetypeIndex, entity);
+            if (observed)
+            {
+                QueueTransition(NoArchetype, archetypeIndex, entity, data != nullptr);
+            }
         }
 
-        return entity;
+        return entities;
     }
 
     void Engine::DeleteEntity(const Entity& entity)
     {
-        auto& loc = m_EntityLocations[entity.index];
-        ECS_ASSERT(entity.id == loc.entityId);
-        loc.entityId = 0;
+        auto& loc = m_EntityLocations[entity.Index()];
+        ECS_ASSERT(loc.Holds(entity));
+        if (loc.Release())
+        {
+            m_FreeEntetyLocationIndices.push(entity.Index());
+        }
 
-        for (auto system : m_Systems)
+        QueueEntityEvent(m_DestroyedEvents, loc.archetype, entity);
+        if (IsObserved(loc.archetype, NoArchetype))
         {
-            system->OnEntityDestroyed(entity);
+            QueueTransition(loc.archetype, NoArchetype, entity, false);
         }
 
         Archetype& archetype = GetArchetype(loc.archetype);
         auto moved           = archetype.DestroyEntity(loc.chunk, loc.position);
-        m_FreeEntetyLocationIndices.push(entity.index);
         m_EntityCount--;
-        m_EntityLocations[moved.index] = EntityLocation(loc.archetype, loc.chunk, loc.position, moved.id);
+
+        // Unless the entity was the last one, another entity took its place
+        if (m_EntityLocations[moved.Index()].Holds(moved))
+        {
+            m_EntityLocations[moved.Index()] = EntityLocation(loc.archetype, loc.chunk, loc.position, moved.id);
+        }
+    }
+
+    void Engine::DestroyEntities(const ComponentFilter& filter)
+    {
+        for (const auto archetypeIndex : GetQuery(filter).archetypes)
+        {
+            Archetype& archetype = m_Archetypes[archetypeIndex];
+            if (archetype.EntityCount() == 0)
+                continue;
+
+            const bool observed = IsObserved(archetypeIndex, NoArchetype);
+            for (Index i = 0; i <= archetype.ActiveChunkIndex(); i++)
+            {
+                const auto entities = archetype.m_Chunks[i]->GetColumn<Entity>();
+                for (const auto& entity : entities)
+                {
+                    if (m_EntityLocations[entity.Index()].Release())
+                    {
+                        m_FreeEntetyLocationIndices.push(entity.Index());
+                    }
+                    QueueEntityEvent(m_DestroyedEvents, archetypeIndex, entity);
+                    if (observed)
+                    {
+                        QueueTransition(archetypeIndex, NoArchetype, entity, false);
+                    }
+                }
+                m_EntityCount -= entities.size();
+            }
+
+            archetype.Clear();
+        }
+    }
+
+    void Engine::DestroyEntities(std::span<const Entity> entities)
+    {
+        std::vector<EntityLocation> locations;
+        locations.reserve(entities.size());
+        for (const auto& entity : entities)
+        {
+            auto& loc = m_EntityLocations[entity.Index()];
+            ECS_ASSERT(loc.Holds(entity));
+            locations.push_back(loc);
+            if (loc.Release())
+            {
+                m_FreeEntetyLocationIndices.push(entity.Index());
+            }
+            QueueEntityEvent(m_DestroyedEvents, loc.archetype, entity);
+            if (IsObserved(loc.archetype, NoArchetype))
+            {
+                QueueTransition(loc.archetype, NoArchetype, entity, false);
+            }
+        }
+        m_EntityCount -= entities.size();
+
+        // Chunks before the active one are full, so this is back to front within each archetype
+        const auto key = [](const EntityLocation& l) { return std::tuple<Index, Index, Index>(l.archetype, l.chunk, l.position); };
+        std::sort(locations.begin(), locations.end(), [&](const EntityLocation& a, const EntityLocation& b) { return key(a) > key(b); });
+
+        for (const auto& loc : locations)
+        {
+            auto moved = GetArchetype(loc.archetype).DestroyEntity(loc.chunk, loc.position);
+            if (m_EntityLocations[moved.Index()].Holds(moved))
+            {
+                m_EntityLocations[moved.Index()] = EntityLocation(loc.archetype, loc.chunk, loc.position, moved.id);
+            }
+        }
     }
 
     std::optional<Index> Engine::GetArchetypeIndex(const ComponentList& components) const
@@ -74,104 +171,555 @@ namespace EVA::ECS
     Archetype& Engine::GetArchetype(Index index) { return m_Archetypes[index]; }
 
     std::vector<Archetype*> Engine::GetArchetypes(const ComponentList& components, bool allowEmpty)
+    {
+        ComponentFilter filter;
+        for (const auto type : components)
+        {
+            filter.AddCompulsory(type);
+        }
+        return GetArchetypes(filter, allowEmpty);
+    }
+
+    std::vector<Archetype*> Engine::GetArchetypes(const ComponentFilter& filter, bool allowEmpty)
     {
         std::vector<Archetype*> archetypes;
-        for (auto [key, value] : m_ArchetypeMap)
+        GetArchetypes(filter, archetypes, allowEmpty);
+        return archetypes;
+    }
+
+    void Engine::GetArchetypes(const ComponentFilter& filter, std::vector<Archetype*>& archetypes, bool allowEmpty)
+    {
+        const auto& query = GetQuery(filter);
+
+        archetypes.clear();
+        for (const auto index : query.archetypes)
         {
-            if (key.Contains(components) && (allowEmpty || m_Archetypes[value].EntityCount() > 0))
+            if (allowEmpty || m_Archetypes[index].EntityCount() > 0)
             {
-                archetypes.push_back(&m_Archetypes[value]);
+                archetypes.push_back(&m_Archetypes[index]);
             }
         }
-        return archetypes;
     }
 
-    std::vector<Archetype*> Engine::GetArchetypes(const ComponentFilter& filter, bool allowEmpty)
+    const Engine::Query& Engine::GetQuery(const ComponentFilter& filter)
     {
-        std::vector<Archetype*> archetypes;
-        for (auto [key, value] : m_ArchetypeMap)
+        std::lock_guard lock(m_QueryMutex);
+
+        auto& query = m_Queries[filter];
+        if (query == nullptr)
         {
-            if (!allowEmpty && m_Archetypes[value].EntityCount() == 0)
-                continue;
+            query         = std::make_unique<Query>();
+            query->filter = filter;
+            for (Index i = 0; i < m_Archetypes.size(); i++)
+            {
+                if (filter.Matches(m_Archetypes[i].GetComponents()))
+                {
+                    query->archetypes.push_back(i);
+                }
+            }
+        }
+        return *query;
+    }
 
-            if (!key.Contains(filter.GetCompulsory()))
-                continue;
+    void Engine::AddComponent(Entity& entity, ComponentType type) { AddComponent(entity, type, nullptr); }
 
-            if (filter.GetExcluded().ContainsAny(key))
-                continue;
+    void Engine::AddComponent(Entity& entity, ComponentType type, const Byte* data)
+    {
+        const auto loc = m_EntityLocations[entity.Index()];
+        ECS_ASSERT(loc.Holds(entity));
 
-            archetypes.push_back(&m_Archetypes[value]);
+        // Already there, only the value changes
+        if (m_Archetypes[loc.archetype].GetComponents().Contains(type))
+        {
+            if (data != nullptr && !ComponentMap::IsTag(type))
+                SetComponent(entity, type, data);
+            return;
         }
-        return archetypes;
+
+        const auto& edge = GetEdge(loc.archetype, type, true);
+        MoveEntity(entity, edge.archetype, edge.columns, data);
     }
 
-    void Engine::AddComponent(Entity& entity, ComponentType type) { AddComponent(entity, type, ComponentMap::DefaultData(type)); }
+    void Engine::RemoveComponent(Entity& entity, ComponentType type)
+    {
+        const auto loc = m_EntityLocations[entity.Index()];
+        ECS_ASSERT(loc.Holds(entity));
+        if (!m_Archetypes[loc.archetype].GetComponents().Contains(type))
+            return;
 
-    void Engine::AddComponent(Entity& entity, ComponentType type, const Byte* data)
+        const auto& edge = GetEdge(loc.archetype, type, false);
+        MoveEntity(entity, edge.archetype, edge.columns, nullptr);
+    }
+
+    void Engine::ChangeComponents(Entity& entity, const ComponentList& add, const ComponentList& remove, const Byte* data)
     {
-        const auto& loc = m_EntityLocations[entity.index];
-        ECS_ASSERT(entity.id == loc.entityId);
-        Archetype& oldArchetype = GetArchetype(loc.archetype);
+        const auto loc = m_EntityLocations[entity.Index()];
+        ECS_ASSERT(loc.Holds(entity));
+
+        // data holds a value for every type in add, set the ones the entity already has in place
+        // and pass only the rest on to the new columns
+        std::vector<Byte> added;
+        if (data != nullptr && m_Archetypes[loc.archetype].GetComponents().ContainsAny(add))
+        {
+            const auto current = m_Archetypes[loc.archetype].GetComponents();
 
-        ComponentList types = oldArchetype.GetComponents();
-        types.Add(type);
-        auto [newArchetypeIndex, newArchetype] = GetOrCreateArchetype(types);
+            size_t offset = 0;
+            for (const auto type : add)
+            {
+                const auto size = ComponentMap::s_Info[type.Get()].size;
+                if (current.Contains(type))
+                {
+                    if (size != 0)
+                        SetComponent(entity, type, &data[offset]);
+                }
+                else
+                {
+                    added.insert(added.end(), &data[offset], &data[offset] + size);
+                }
+                offset += size;
+            }
+            data = added.empty() ? nullptr : added.data();
+        }
 
-        Archetype& archetype = GetArchetype(loc.archetype); // GetOrCreateArchetype may invalidate the refference to archetype
+        ComponentList types = m_Archetypes[loc.archetype].GetComponents();
+        for (const auto type : remove)
+        {
+            types.Remove(type);
+        }
+        for (const auto type : add)
+        {
+            types.Add(type);
+        }
 
-        auto [newChunk, newPosition] = newArchetype.AddEntityAddComponent(archetype, loc.chunk, loc.position, type, data);
+        if (types == m_Archetypes[loc.archetype].GetComponents())
+            return;
 
-        auto moved = archetype.DestroyEntity(loc.chunk, loc.position);
+        const auto& edge = GetChangeEdge(loc.archetype, types);
+        MoveEntity(entity, edge.archetype, edge.columns, data);
+    }
 
-        m_EntityLocations[moved.index]  = EntityLocation(loc.archetype, loc.chunk, loc.position, moved.id);
-        m_EntityLocations[entity.index] = EntityLocation(newArchetypeIndex, newChunk, newPosition, entity.id);
+    void Engine::AddComponentToAll(const ComponentFilter& filter, const ComponentType type, const Byte* data)
+    {
+        MoveAllEntities(filter, type, true, data);
     }
 
-    void Engine::RemoveComponent(Entity& entity, ComponentType type)
+    void Engine::RemoveComponentFromAll(const ComponentFilter& filter, const ComponentType type)
     {
-        const auto& loc = m_EntityLocations[entity.index];
-        ECS_ASSERT(entity.id == loc.entityId);
-        Archetype& oldArchetype = GetArchetype(loc.archetype);
+        MoveAllEntities(filter, type, false, nullptr);
+    }
 
-        ComponentList types = oldArchetype.GetComponents();
-        types.Remove(type);
-        auto [newArchetypeIndex, newArchetype] = GetOrCreateArchetype(types);
+    void Engine::SetComponent(const Entity& entity, const ComponentType type, const Byte* data)
+    {
+        ECS_ASSERT(!ComponentMap::IsTag(type));
+        std::memcpy(GetComponent(entity, type), data, ComponentMap::s_Info[type.Get()].size);
+        if (m_ObservedTypes.Contains(type))
+        {
+            m_Sets.emplace_back(type, entity);
+        }
+    }
 
-        Archetype& archetype = GetArchetype(loc.archetype); // GetOrCreateArchetype may invalidate the refference to archetype
+    void Engine::SetEnabled(const Entity& entity, const ComponentType type, const bool enabled)
+    {
+        const auto& loc = m_EntityLocations[entity.Index()];
+        ECS_ASSERT(loc.Holds(entity));
+        ECS_ASSERT(ComponentMap::IsEnableable(type));
+
+        auto& archetype = GetArchetype(loc.archetype);
+        const auto i    = archetype.GetInfo().GetComponentIndex(type);
+        ECS_ASSERT(i.has_value());
+        archetype.m_Chunks[loc.chunk]->SetEnabled(i.value(), loc.position, enabled);
+    }
 
-        auto [newChunk, newPosition] = newArchetype.AddEntityRemoveComponent(archetype, loc.chunk, loc.position, type);
+    bool Engine::IsEnabled(const Entity& entity, const ComponentType type)
+    {
+        const auto& loc = m_EntityLocations[entity.Index()];
+        ECS_ASSERT(loc.Holds(entity));
 
-        auto moved = archetype.DestroyEntity(loc.chunk, loc.position);
+        auto& archetype = GetArchetype(loc.archetype);
+        const auto i    = archetype.GetInfo().GetComponentIndex(type);
+        return i.has_value() && archetype.m_Chunks[loc.chunk]->IsEnabled(i.value(), loc.position);
+    }
 
-        m_EntityLocations[moved.index]  = EntityLocation(loc.archetype, loc.chunk, loc.position, moved.id);
-        m_EntityLocations[entity.index] = EntityLocation(newArchetypeIndex, newChunk, newPosition, entity.id);
+    void Engine::Observe(const ComponentEvent event, const ComponentType type, ComponentObserver observer)
+    {
+        if (type.Get() >= m_Observers.size())
+        {
+            m_Observers.resize(type.Get() + 1);
+        }
+        m_Observers[type.Get()][static_cast<size_t>(event)].push_back(std::move(observer));
+        m_ObservedTypes.Add(type);
     }
 
     Byte* Engine::GetComponent(const Entity& entity, const ComponentType type)
     {
-        const auto& loc = m_EntityLocations[entity.index];
-        ECS_ASSERT(entity.id == loc.entityId);
+        const auto& loc = m_EntityLocations[entity.Index()];
+        ECS_ASSERT(loc.Holds(entity));
+        GetArchetype(loc.archetype).m_Chunks[loc.chunk]->MarkChanged(type);
         return GetArchetype(loc.archetype).GetComponent(type, loc.chunk, loc.position);
     }
 
+    void Engine::FlushEntityEvents()
+    {
+        FlushEntityEvents(m_CreatedEvents, &System::OnEntitiesCreated);
+        FlushComponentEvents();
+        FlushEntityEvents(m_DestroyedEvents, &System::OnEntitiesDestroyed);
+    }
+
+    void Engine::FlushEntityEvents(std::vector<EntityEvent>& events, void (System::*callback)(std::span<const Entity>))
+    {
+        if (events.empty())
+            return;
+
+        // Callbacks may queue new events, those are delivered by the next flush
+        std::swap(events, m_FlushEvents);
+        // Grouped by archetype, within an archetype the events keep the order they were queued in
+        std::sort(m_FlushEvents.begin(), m_FlushEvents.end(),
+        [](const EntityEvent& a, const EntityEvent& b) { return std::tie(a.archetype, a.order) < std::tie(b.archetype, b.order); });
+
+        m_FlushEntities.clear();
+        for (const auto& event : m_FlushEvents)
+        {
+            m_FlushEntities.push_back(event.entity);
+        }
+
+        for (Index begin = 0; begin < m_FlushEvents.size();)
+        {
+            const auto archetype = m_FlushEvents[begin].archetype;
+            Index end            = begin;
+            while (end < m_FlushEvents.size() && m_FlushEvents[end].archetype == archetype)
+            {
+                end++;
+            }
+
+            const auto entities = std::span<const Entity>(m_FlushEntities).subspan(begin, end - begin);
+            for (auto* system : m_EventSystems)
+            {
+                if (system->m_EventFilter->Matches(m_Archetypes[archetype].GetComponents()))
+                {
+                    (system->*callback)(entities);
+                }
+            }
+            begin = end;
+        }
+
+        m_FlushEvents.clear();
+    }
+
+    void Engine::FlushComponentEvents()
+    {
+        if (!m_Transitions.empty())
+        {
+            std::swap(m_Transitions, m_FlushTransitions);
+            std::sort(m_FlushTransitions.begin(), m_FlushTransitions.end(),
+            [](const ComponentTransition& a, const ComponentTransition& b)
+            { return std::tie(a.from, a.to, a.set, a.order) < std::tie(b.from, b.to, b.set, b.order); });
+
+            m_FlushEntities.clear();
+            for (const auto& transition : m_FlushTransitions)
+            {
+                m_FlushEntities.push_back(transition.entity);
+            }
+
+            for (Index begin = 0; begin < m_FlushTransitions.size();)
+            {
+                const auto& first = m_FlushTransitions[begin];
+                Index end         = begin;
+                while (end < m_FlushTransitions.size() && m_FlushTransitions[end].from == first.from && m_FlushTransitions[end].to == first.to &&
+                       m_FlushTransitions[end].set == first.set)
+                {
+                    end++;
+                }
+
+                // Copied since observers may create archetypes
+                const auto from     = first.from == NoArchetype ? ComponentList() : m_Archetypes[first.from].GetComponents();
+                const auto to       = first.to == NoArchetype ? ComponentList() : m_Archetypes[first.to].GetComponents();
+                const bool set      = first.set;
+                const auto entities = std::span<const Entity>(m_FlushEntities).subspan(begin, end - begin);
+
+                for (const auto type : to)
+                {
+                    if (from.Contains(type))
+                        continue;
+
+                    Notify(ComponentEvent::Add, type, entities);
+                    if (set)
+                    {
+                        Notify(ComponentEvent::Set, type, entities);
+                    }
+                }
+                for (const auto type : from)
+                {
+                    if (!to.Contains(type))
+                    {
+                        Notify(ComponentEvent::Remove, type, entities);
+                    }
+                }
+                begin = end;
+            }
+            m_FlushTransitions.clear();
+        }
+
+        if (!m_Sets.empty())
+        {
+            std::swap(m_Sets, m_FlushSets);
+            std::sort(m_FlushSets.begin(), m_FlushSets.end(),
+            [](const ComponentSet& a, const ComponentSet& b) { return std::tie(a.type, a.entity.id) < std::tie(b.type, b.entity.id); });
+
+            m_FlushEntities.clear();
+            for (const auto& set : m_FlushSets)
+            {
+                m_FlushEntities.push_back(set.entity);
+            }
+
+            for (Index begin = 0; begin < m_FlushSets.size();)
+            {
+                const auto type = m_FlushSets[begin].type;
+                Index end       = begin;
+                while (end < m_FlushSets.size() && m_FlushSets[end].type == type)
+                {
+                    end++;
+                }
+                Notify(ComponentEvent::Set, type, std::span<const Entity>(m_FlushEntities).subspan(begin, end - begin));
+                begin = end;
+            }
+            m_FlushSets.clear();
+        }
+    }
+
+    void Engine::Notify(const ComponentEvent event, const ComponentType type, std::span<const Entity> entities)
+    {
+        if (type.Get() >= m_Observers.size())
+            return;
+
+        for (const auto& observer : m_Observers[type.Get()][static_cast<size_t>(event)])
+        {
+            observer(entities);
+        }
+    }
+
     void Engine::UpdateSystems()
     {
+        FlushEntityEvents();
+
         for (const auto& s : m_Systems)
         {
-            s->Update();
+            s->RunUpdate();
+        }
+    }
+
+    void Engine::UpdateSystemsParallel()
+    {
+        FlushEntityEvents();
+
+        for (const auto& level : GetSystemLevels())
+        {
+            JobSystem::Global().ParallelFor(level.size(), [&](size_t i) { level[i]->RunUpdate(); });
+        }
+    }
+
+    const std::vector<std::vector<System*>>& Engine::GetSystemLevels()
+    {
+        if (m_SystemLevelsDirty)
+        {
+            BuildSystemLevels();
         }
+        return m_SystemLevels;
+    }
+
+    void Engine::BuildSystemLevels()
+    {
+        // A system goes one level after the last earlier system it conflicts with
+        std::vector<Index> levels(m_Systems.size(), 0);
+        m_SystemLevels.clear();
+
+        for (Index i = 0; i < m_Systems.size(); i++)
+        {
+            for (Index j = 0; j < i; j++)
+            {
+                if (m_Systems[i]->ConflictsWith(*m_Systems[j]))
+                {
+                    levels[i] = std::max(levels[i], levels[j] + 1);
+                }
+            }
+
+            if (levels[i] >= m_SystemLevels.size())
+            {
+                m_SystemLevels.resize(levels[i] + 1);
+            }
+            m_SystemLevels[levels[i]].push_back(m_Systems[i].get());
+        }
+
+        m_SystemLevelsDirty = false;
+    }
+
+    void Engine::ShrinkToFit()
+    {
+        for (Index i = 0; i < m_Archetypes.size(); i++)
+        {
+            m_Archetypes[i].ShrinkToFit([&](const Entity& entity, Index chunk, Index position)
+            { m_EntityLocations[entity.Index()] = EntityLocation(i, chunk, position, entity.id); });
+        }
+        ChunkPool::Global().Trim();
     }
 
     Entity Engine::GetNextEntity()
     {
+        Index index = m_EntityLocations.size();
+        if (!m_FreeEntetyLocationIndices.empty())
+        {
+            index = m_FreeEntetyLocationIndices.top();
+            m_FreeEntetyLocationIndices.pop();
+        }
+        else
+        {
+#ifdef EVA_ECS_COMPACT_ENTITY
+            if (index > std::numeric_limits<EntityIndex>::max())
+                throw std::length_error("Too many entities for EVA_ECS_COMPACT_ENTITY");
+#endif
+            m_EntityLocations.emplace_back();
+        }
         m_EntityCount++;
-        return Entity(m_EntityIdCounter++);
+
+#ifdef EVA_ECS_COMPACT_ENTITY
+        return Entity(static_cast<EntityIndex>(index), m_EntityLocations[index].generation);
+#else
+        return Entity(m_EntityIdCounter++, index);
+#endif
+    }
+
+    const Archetype::Edge& Engine::GetEdge(const Index archetypeIndex, const ComponentType type, const bool add)
+    {
+        const auto getEdge = [&](Index index, bool addEdge) -> Archetype::Edge&
+        { return addEdge ? m_Archetypes[index].GetAddEdge(type) : m_Archetypes[index].GetRemoveEdge(type); };
+
+        if (const auto& edge = getEdge(archetypeIndex, add); edge.archetype != Archetype::Edge::None)
+            return edge;
+
+        ComponentList types = m_Archetypes[archetypeIndex].GetComponents();
+        if (add)
+            types.Add(type);
+        else
+            types.Remove(type);
+
+        // Creating the target may reallocate m_Archetypes, so edges are looked up after it exists
+        const auto targetIndex = GetOrCreateArchetype(types).first;
+
+        auto& edge     = getEdge(archetypeIndex, add);
+        edge.archetype = targetIndex;
+        edge.columns   = ColumnMap::Create(m_Archetypes[archetypeIndex].GetInfo(), m_Archetypes[targetIndex].GetInfo());
+
+        // The way back is the opposite edge of the target
+        if (auto& back = getEdge(targetIndex, !add); back.archetype == Archetype::Edge::None)
+        {
+            back.archetype = archetypeIndex;
+            back.columns   = ColumnMap::Create(m_Archetypes[targetIndex].GetInfo(), m_Archetypes[archetypeIndex].GetInfo());
+        }
+
+        return edge;
+    }
+
+    const Archetype::Edge& Engine::GetChangeEdge(const Index archetypeIndex, const ComponentList& types)
+    {
+        if (const auto& edge = m_Archetypes[archetypeIndex].GetChangeEdge(types); edge.archetype != Archetype::Edge::None)
+            return edge;
+
+        // Creating the target may reallocate m_Archetypes, so the edge is looked up after it exists
+        const auto targetIndex = GetOrCreateArchetype(types).first;
+
+        auto& edge     = m_Archetypes[archetypeIndex].GetChangeEdge(types);
+        edge.archetype = targetIndex;
+        edge.columns   = ColumnMap::Create(m_Archetypes[archetypeIndex].GetInfo(), m_Archetypes[targetIndex].GetInfo());
+        return edge;
+    }
+
+    void Engine::MoveEntity(const Entity& entity, const Index archetype, const ColumnMap& columns, const Byte* data)
+    {
+        const auto loc = m_EntityLocations[entity.Index()];
+
+        Archetype& oldArchetype = GetArchetype(loc.archetype);
+        Archetype& newArchetype = GetArchetype(archetype);
+
+        auto [newChunk, newPosition] = newArchetype.AddEntity(oldArchetype, loc.chunk, loc.position, columns, data);
+
+        auto moved = oldArchetype.DestroyEntity(loc.chunk, loc.position);
+
+        m_EntityLocations[moved.Index()]  = EntityLocation(loc.archetype, loc.chunk, loc.position, moved.id);
+        m_EntityLocations[entity.Index()] = EntityLocation(archetype, newChunk, newPosition, entity.id);
+
+        if (IsObserved(loc.archetype, archetype))
+        {
+            QueueTransition(loc.archetype, archetype, entity, data != nullptr);
+        }
+    }
+
+    void Engine::MoveAllEntities(const ComponentFilter& filter, const ComponentType type, const bool add, const Byte* data)
+    {
+        // Copied since creating target archetypes appends to the query
+        const auto sources = GetQuery(filter).archetypes;
+
+        for (const auto from : sources)
+        {
+            if (m_Archetypes[from].EntityCount() == 0 || m_Archetypes[from].GetComponents().Contains(type) == add)
+                continue;
+
+            const auto& edge    = GetEdge(from, type, add);
+            Archetype& source   = m_Archetypes[from];
+            Archetype& target   = m_Archetypes[edge.archetype];
+            const bool observed = IsObserved(from, edge.archetype);
+
+            if (target.EntityCount() == 0 && edge.columns.added.empty() && source.GetInfo().columnCount == target.GetInfo().columnCount &&
+                source.GetInfo().enableable == target.GetInfo().enableable)
+            {
+                target.TakeChunks(source);
+                for (Index c = 0; c <= target.ActiveChunkIndex(); c++)
+                {
+                    for (const auto& entity : target.m_Chunks[c]->GetColumn<Entity>())
+                    {
+                        auto& loc = m_EntityLocations[entity.Index()];
+                        loc       = EntityLocation(edge.archetype, loc.chunk, loc.position, entity.id);
+                        if (observed)
+                        {
+                            QueueTransition(from, edge.archetype, entity, data != nullptr);
+                        }
+                    }
+                }
+                continue;
+            }
+
+            for (Index c = 0; c <= source.ActiveChunkIndex(); c++)
+            {
+                target.AddEntities(source, c, edge.columns, data,
+                [&](Index chunk, Index first, std::span<const Entity> moved)
+                {
+                    for (Index i = 0; i < moved.size(); i++)
+                    {
+                        m_EntityLocations[moved[i].Index()] = EntityLocation(edge.archetype, chunk, first + i, moved[i].id);
+                        if (observed)
+                        {
+                            QueueTransition(from, edge.archetype, moved[i], data != nullptr);
+                        }
+                    }
+                });
+            }
+            source.Clear();
+        }
     }
 
     Archetype& Engine::CreateArchetype(const ComponentList& components)
     {
         m_Archetypes.emplace_back(components);
         m_ArchetypeMap.emplace(components, m_Archetypes.size() - 1);
+
+        {
+            std::lock_guard lock(m_QueryMutex);
+            for (auto& [filter, query] : m_Queries)
+            {
+                if (filter.Matches(components))
+                {
+                    query->archetypes.push_back(m_Archetypes.size() - 1);
+                }
+            }
+        }
         return m_Archetypes[m_Archetypes.size() - 1];
     }
 
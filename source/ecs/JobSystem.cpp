@@ -0,0 +1,172 @@
+#include "JobSystem.hpp"
+
+namespace EVA::ECS
+{
+    namespace
+    {
+        // Set for the threads owned by a pool so nested ParallelFor calls use their own deque
+        thread_local const JobSystem* t_JobSystem = nullptr;
+        thread_local size_t t_QueueIndex          = 0;
+    } // namespace
+
+    JobSystem::JobSystem(const size_t workerCount) { Start(workerCount); }
+
+    JobSystem::~JobSystem() { Stop(); }
+
+    JobSystem& JobSystem::Global()
+    {
+        static JobSystem jobSystem;
+        return jobSystem;
+    }
+
+    size_t JobSystem::DefaultWorkerCount() { return std::max<size_t>(1, std::thread::hardware_concurrency()); }
+
+    void JobSystem::SetWorkerCount(const size_t workerCount)
+    {
+        Stop();
+        Start(workerCount);
+    }
+
+    void JobSystem::Start(const size_t workerCount)
+    {
+        const auto threadCount = std::max<size_t>(1, workerCount) - 1;
+
+        m_Stop = false;
+        m_Queues.clear();
+        for (size_t i = 0; i < threadCount + 1; i++)
+        {
+            m_Queues.push_back(std::make_unique<Queue>());
+        }
+
+        for (size_t i = 0; i < threadCount; i++)
+        {
+            m_Workers.emplace_back([this, i] { WorkerLoop(i); });
+        }
+    }
+
+    void JobSystem::Stop()
+    {
+        {
+            std::lock_guard lock(m_WakeMutex);
+            m_Stop = true;
+        }
+        m_WakeCondition.notify_all();
+
+        for (auto& worker : m_Workers)
+        {
+            worker.join();
+        }
+        m_Workers.clear();
+    }
+
+    void JobSystem::WorkerLoop(const size_t queueIndex)
+    {
+        t_JobSystem  = this;
+        t_QueueIndex = queueIndex;
+
+        while (true)
+        {
+            if (TryRunJob(queueIndex))
+                continue;
+
+            std::unique_lock lock(m_WakeMutex);
+            m_WakeCondition.wait(lock, [this] { return m_Stop || m_QueuedCount.load() > 0; });
+            if (m_Stop)
+                return;
+        }
+    }
+
+    size_t JobSystem::CurrentQueue() const { return t_JobSystem == this ? t_QueueIndex : m_Queues.size() - 1; }
+
+    void JobSystem::Push(const Job& job)
+    {
+        auto& queue = *m_Queues[m_NextQueue.fetch_add(1) % m_Queues.size()];
+        m_QueuedCount++;
+        std::lock_guard lock(queue.mutex);
+        queue.jobs.push_back(job);
+    }
+
+    bool JobSystem::TryPop(const size_t queueIndex, Job& job)
+    {
+        // Own deque from the back, then steal from the front of the others
+        {
+            auto& queue = *m_Queues[queueIndex];
+            std::lock_guard lock(queue.mutex);
+            if (queue.head < queue.jobs.size())
+            {
+                job = queue.jobs.back();
+                queue.jobs.pop_back();
+                if (queue.head == queue.jobs.size())
+                {
+                    queue.jobs.clear();
+                    queue.head = 0;
+                }
+                m_QueuedCount--;
+                return true;
+            }
+        }
+
+        for (size_t i = 1; i < m_Queues.size(); i++)
+        {
+            auto& queue = *m_Queues[(queueIndex + i) % m_Queues.size()];
+            std::lock_guard lock(queue.mutex);
+            if (queue.head < queue.jobs.size())
+            {
+                job = queue.jobs[queue.head++];
+                if (queue.head == queue.jobs.size())
+                {
+                    queue.jobs.clear();
+                    queue.head = 0;
+                }
+                m_QueuedCount--;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool JobSystem::TryRunJob(const size_t queueIndex)
+    {
+        Job job;
+        if (!TryPop(queueIndex, job))
+            return false;
+
+        job.function(job.context, job.index);
+        job.remaining->fetch_sub(1, std::memory_order_acq_rel);
+        return true;
+    }
+
+    void JobSystem::Run(const size_t count, void (*function)(void*, size_t), void* context)
+    {
+        if (m_Workers.empty() || count == 1)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                function(context, i);
+            }
+            return;
+        }
+
+        std::atomic<size_t> remaining = count;
+        for (size_t i = 0; i < count; i++)
+        {
+            Push({ function, context, i, &remaining });
+        }
+        {
+            // Workers check the queued count under this mutex before sleeping, so the wake up can not be missed
+            std::lock_guard lock(m_WakeMutex);
+        }
+        m_WakeCondition.notify_all();
+
+        // Help with any queued job while waiting, this keeps nested calls from deadlocking
+        const auto queueIndex = CurrentQueue();
+        while (remaining.load(std::memory_order_acquire) > 0)
+        {
+            if (!TryRunJob(queueIndex))
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+} // namespace EVA::ECS
@@ -4,5 +4,28 @@
 namespace EVA::ECS
 {
     Engine& System::GetEngine() { return *m_Engine; }
-    std::vector<Archetype*> System::GetArchetypes(const ComponentFilter& filter) { return m_Engine->GetArchetypes(filter, false); }
+
+    bool System::ConflictsWith(const System& other) const
+    {
+        if (!m_DeclaredAccess || !other.m_DeclaredAccess)
+            return true;
+
+        return m_Writes.ContainsAny(other.m_Writes) || m_Writes.ContainsAny(other.m_Reads) || m_Reads.ContainsAny(other.m_Writes);
+    }
+
+    void System::GetArchetypes(const ComponentFilter& filter, std::vector<Archetype*>& archetypes)
+    {
+        m_Engine->GetArchetypes(filter, archetypes, false);
+    }
+
+    void System::RunUpdate()
+    {
+        m_Version = ChangeVersion::Next();
+        Update();
+        m_LastVersion = m_Version;
+        m_Version     = 0;
+
+        // Anything written from here on is newer than this update
+        ChangeVersion::Next();
+    }
 } // namespace EVA::ECS
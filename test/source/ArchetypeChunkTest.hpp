@@ -10,7 +10,9 @@ namespace EVA::ECS
         ArchetypeInfo ai(cl);
 
         EXPECT_EQ(ai.entitySize, sizeof(Entity) + sizeof(Position) + sizeof(StructComponentA));
-        EXPECT_EQ(ai.entitiesPerChunk, ai.chunkSize / ai.entitySize);
+        EXPECT_LE(ai.entitiesPerChunk, ai.chunkSize / ai.entitySize);
+        EXPECT_LE(ai.DataSize(ai.entitiesPerChunk), ai.chunkSize);
+        EXPECT_GT(ai.DataSize(ai.entitiesPerChunk + 1), ai.chunkSize);
         EXPECT_EQ(ai.componentInfo.size(), 3);
     }
 
@@ -23,15 +25,49 @@ namespace EVA::ECS
         EXPECT_EQ(ai.componentInfo[0].type, Entity::GetType());
         EXPECT_EQ(ai.componentInfo[0].size, sizeof(Entity));
 
-        EXPECT_EQ(ai.componentInfo[1].start, ai.entitiesPerChunk * sizeof(Entity));
+        EXPECT_EQ(ai.componentInfo[1].start, AlignUp(ai.entitiesPerChunk * sizeof(Entity), CacheLineSize));
         EXPECT_EQ(ai.componentInfo[1].type, Position::GetType());
         EXPECT_EQ(ai.componentInfo[1].size, sizeof(Position));
 
-        EXPECT_EQ(ai.componentInfo[2].start, ai.entitiesPerChunk * (sizeof(Entity) + sizeof(Position)));
+        EXPECT_EQ(ai.componentInfo[2].start, AlignUp(ai.componentInfo[1].start + ai.entitiesPerChunk * sizeof(Position), CacheLineSize));
         EXPECT_EQ(ai.componentInfo[2].type, StructComponentA::GetType());
         EXPECT_EQ(ai.componentInfo[2].size, sizeof(StructComponentA));
     }
 
+    TEST(ArchetypeInfo, Alignment)
+    {
+        ComponentList cl({ Position::GetType(), StructComponentA::GetType(), AlignedComp::GetType() });
+        ArchetypeInfo ai(cl, ArchetypeInfo::ChunkSizeFor(cl, 7));
+
+        EXPECT_EQ(ai.entitiesPerChunk, 7);
+        EXPECT_EQ(ai.alignment, alignof(AlignedComp));
+        for (const auto& c : ai.componentInfo)
+        {
+            EXPECT_EQ(c.start % CacheLineSize, 0);
+            EXPECT_EQ(c.start % c.alignment, 0);
+        }
+
+        ArchetypeChunk ac(ai);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(ac.Data()) % ai.alignment, 0);
+    }
+
+    TEST(ArchetypeInfo, Tags)
+    {
+        ComponentList cl({ Position::GetType(), Comp0::GetType(), Comp1::GetType() });
+        ArchetypeInfo ai(cl);
+        ArchetypeInfo aiNoTags(ComponentList::Create<Position>());
+
+        EXPECT_EQ(ai.componentInfo.size(), 4);
+        EXPECT_EQ(ai.columnCount, 2);
+        EXPECT_EQ(ai.entitySize, sizeof(Entity) + sizeof(Position));
+        EXPECT_EQ(ai.entitiesPerChunk, aiNoTags.entitiesPerChunk);
+
+        EXPECT_EQ(ai.GetComponentIndex(Position::GetType()), 1);
+        EXPECT_TRUE(ai.GetComponentIndex(Comp0::GetType()).has_value());
+        EXPECT_TRUE(ai.GetComponentIndex(Comp1::GetType()).has_value());
+        EXPECT_EQ(ai.componentInfo[ai.GetComponentIndex(Comp0::GetType()).value()].size, 0);
+    }
+
     TEST(ArchetypeInfo, GetComponentIndex)
     {
         ComponentList cl({ Position::GetType(), StructComponentA::GetType() });
@@ -40,12 +76,20 @@ namespace EVA::ECS
         EXPECT_EQ(ai.GetComponentIndex(Entity::GetType()), 0);
         EXPECT_EQ(ai.GetComponentIndex(Position::GetType()), 1);
         EXPECT_EQ(ai.GetComponentIndex(StructComponentA::GetType()), 2);
+
+        EXPECT_FALSE(ai.GetComponentIndex(Velocity::GetType()).has_value());
+        EXPECT_FALSE(ai.GetComponentIndex(ComponentType(ComponentMap::s_IdCounter + 100)).has_value());
+
+        for (const auto& c : ai.componentInfo)
+        {
+            EXPECT_EQ(ai.componentInfo[ai.GetComponentIndex(c.type).value()].type, c.type);
+        }
     }
 
     TEST(ArchetypeChunk, CreateEntity)
     {
         ComponentList cl({ Position::GetType(), StructComponentA::GetType() });
-        size_t chunkSize = 4 * (sizeof(Entity) + sizeof(Position) + sizeof(StructComponentA));
+        size_t chunkSize = ArchetypeInfo::ChunkSizeFor(cl, 4);
         ArchetypeInfo ai(cl, chunkSize);
         ArchetypeChunk ac(ai);
 
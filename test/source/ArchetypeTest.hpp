@@ -7,7 +7,7 @@ namespace EVA::ECS
     TEST(Archetype, CreateGetDestroy)
     {
         ComponentList cl({ Position::GetType(), StructComponentA::GetType() });
-        size_t chunkSize = 4 * (sizeof(Entity) + sizeof(Position) + sizeof(StructComponentA));
+        size_t chunkSize = ArchetypeInfo::ChunkSizeFor(cl, 4);
         Archetype a(cl, chunkSize);
 
         EXPECT_EQ(a.EntityCount(), 0);
@@ -65,7 +65,7 @@ namespace EVA::ECS
     TEST(Archetype, GetComponentChunkIndex)
     {
         ComponentList cl({ Position::GetType(), StructComponentA::GetType() });
-        size_t chunkSize = 4 * (sizeof(Entity) + sizeof(Position) + sizeof(StructComponentA));
+        size_t chunkSize = ArchetypeInfo::ChunkSizeFor(cl, 4);
         Archetype a(cl, chunkSize);
 
         for (size_t i = 0; i < 20; i++)
@@ -89,7 +89,7 @@ namespace EVA::ECS
     TEST(Archetype, GetComponentArchetypeIndex)
     {
         ComponentList cl({ Position::GetType(), StructComponentA::GetType() });
-        size_t chunkSize = 4 * (sizeof(Entity) + sizeof(Position) + sizeof(StructComponentA));
+        size_t chunkSize = ArchetypeInfo::ChunkSizeFor(cl, 4);
         Archetype a(cl, chunkSize);
 
         for (size_t i = 0; i < 20; i++)
@@ -135,11 +135,11 @@ namespace EVA::ECS
     TEST(Archetype, AddComponent)
     {
         ComponentList cl1({ Position::GetType(), StructComponentA::GetType() });
-        size_t chunkSize1 = 5 * (sizeof(Entity) + sizeof(Position) + sizeof(StructComponentA));
+        size_t chunkSize1 = ArchetypeInfo::ChunkSizeFor(cl1, 5);
         Archetype a1(cl1, chunkSize1);
 
         ComponentList cl2({ Position::GetType(), Velocity::GetType(), StructComponentA::GetType() });
-        size_t chunkSize2 = 5 * (sizeof(Entity) + sizeof(Position) + sizeof(Velocity) + sizeof(StructComponentA));
+        size_t chunkSize2 = ArchetypeInfo::ChunkSizeFor(cl2, 5);
         Archetype a2(cl2, chunkSize2);
 
         for (size_t i = 0; i < 25; i++)
@@ -234,11 +234,11 @@ namespace EVA::ECS
     TEST(Archetype, RemoveComponent)
     {
         ComponentList cl1({ Position::GetType(), StructComponentA::GetType() });
-        size_t chunkSize1 = 5 * (sizeof(Entity) + sizeof(Position) + sizeof(StructComponentA));
+        size_t chunkSize1 = ArchetypeInfo::ChunkSizeFor(cl1, 5);
         Archetype a1(cl1, chunkSize1);
 
         ComponentList cl2({ Position::GetType(), Velocity::GetType(), StructComponentA::GetType() });
-        size_t chunkSize2 = 5 * (sizeof(Entity) + sizeof(Position) + sizeof(Velocity) + sizeof(StructComponentA));
+        size_t chunkSize2 = ArchetypeInfo::ChunkSizeFor(cl2, 5);
         Archetype a2(cl2, chunkSize2);
 
         for (size_t i = 0; i < 25; i++)
@@ -330,11 +330,11 @@ namespace EVA::ECS
     TEST(Archetype, EntityIterator)
     {
         ComponentList cl1 = ComponentList::Create<Position, StructComponentA>();
-        size_t chunkSize1 = 4 * (sizeof(Entity) + sizeof(Position) + sizeof(StructComponentA));
+        size_t chunkSize1 = ArchetypeInfo::ChunkSizeFor(cl1, 4);
         Archetype a1(cl1, chunkSize1);
 
         ComponentList cl2 = ComponentList::Create<Position, Velocity>();
-        size_t chunkSize2 = 4 * (sizeof(Entity) + sizeof(Position) + sizeof(Velocity));
+        size_t chunkSize2 = ArchetypeInfo::ChunkSizeFor(cl2, 4);
         Archetype a2(cl2, chunkSize2);
 
         for (size_t i = 0; i < 20; i++)
@@ -366,11 +366,11 @@ namespace EVA::ECS
     TEST(Archetype, EntityIteratorOptional)
     {
         ComponentList cl1 = ComponentList::Create<Position, StructComponentA>();
-        size_t chunkSize1 = 4 * (sizeof(Entity) + sizeof(Position) + sizeof(StructComponentA));
+        size_t chunkSize1 = ArchetypeInfo::ChunkSizeFor(cl1, 4);
         Archetype a1(cl1, chunkSize1);
 
         ComponentList cl2 = ComponentList::Create<Position, Velocity>();
-        size_t chunkSize2 = 4 * (sizeof(Entity) + sizeof(Position) + sizeof(Velocity));
+        size_t chunkSize2 = ArchetypeInfo::ChunkSizeFor(cl2, 4);
         Archetype a2(cl2, chunkSize2);
 
         for (size_t i = 0; i < 20; i++)
@@ -434,11 +434,11 @@ namespace EVA::ECS
     TEST(Archetype, EntityIteratorRandomAccess)
     {
         ComponentList cl1 = ComponentList::Create<Position, StructComponentA>();
-        size_t chunkSize1 = 4 * (sizeof(Entity) + sizeof(Position) + sizeof(StructComponentA));
+        size_t chunkSize1 = ArchetypeInfo::ChunkSizeFor(cl1, 4);
         Archetype a1(cl1, chunkSize1);
 
         ComponentList cl2 = ComponentList::Create<Position, Velocity>();
-        size_t chunkSize2 = 4 * (sizeof(Entity) + sizeof(Position) + sizeof(Velocity));
+        size_t chunkSize2 = ArchetypeInfo::ChunkSizeFor(cl2, 4);
         Archetype a2(cl2, chunkSize2);
 
         for (size_t i = 0; i < 20; i++)
@@ -471,4 +471,178 @@ namespace EVA::ECS
             EXPECT_EQ(a2.GetComponent<Position>(i).x, a2.GetComponent<Entity>(i).id * 10);
         }
     }
+
+    TEST(Archetype, EntityIteratorSplit)
+    {
+        ComponentList cl = ComponentList::Create<Position>();
+        Archetype a1(cl, ArchetypeInfo::ChunkSizeFor(cl, 7));
+        ComponentList cl2 = ComponentList::Create<Position, Velocity>();
+        Archetype a2(cl2, ArchetypeInfo::ChunkSizeFor(cl2, 7));
+
+        for (size_t i = 0; i < 50; i++)
+            a1.CreateEntity(Entity(i));
+        for (size_t i = 50; i < 103; i++)
+            a2.CreateEntity(Entity(i));
+
+        EntityIterator<Entity> it({ &a1, &a2 });
+        EXPECT_EQ(it.Count(), 103);
+
+        for (size_t i = 0; i < it.Count(); i++)
+        {
+            EXPECT_EQ(std::get<0>(it[i]).id, i);
+            EXPECT_EQ(std::get<0>(*(it.begin() + i)).id, i);
+        }
+
+        size_t next = 0;
+        for (auto [b, e] : it.Split(6))
+        {
+            EXPECT_EQ(b.Pos(), next);
+            for (auto i = b; i != e; ++i)
+            {
+                EXPECT_EQ(std::get<0>(*i).id, next++);
+            }
+        }
+        EXPECT_EQ(next, 103);
+
+        // Chunks of 7 with a target of 18 per range: 0-21 and 21-42 are three chunks of a1, 42-64 takes the last
+        // 7 + 1 of a1 and two chunks of a2, 64-85 is three more chunks of a2 and 85-103 the remaining 7 + 7 + 4
+        std::vector<std::pair<Index, Index>> ranges;
+        for (auto [b, e] : it.Split(6, SplitMode::Chunks))
+        {
+            ranges.emplace_back(b.Pos(), e.Pos());
+        }
+        EXPECT_EQ(ranges, (std::vector<std::pair<Index, Index>>{ { 0, 21 }, { 21, 42 }, { 42, 64 }, { 64, 85 }, { 85, 103 } }));
+
+        std::atomic<size_t> sum = 0;
+        it.Process(4, [&](auto t) { sum += std::get<0>(t).id; }, SplitMode::Chunks);
+        EXPECT_EQ(sum, 103 * 102 / 2);
+    }
+
+    TEST(Archetype, EntityIteratorForEachChunk)
+    {
+        auto cl = ComponentList::Create<Position, IntComp>();
+        Archetype a0(cl, ArchetypeInfo::ChunkSizeFor(cl, 10));
+        Archetype a1(ComponentList::Create<Position>(), ArchetypeInfo::ChunkSizeFor(cl, 10));
+
+        for (int i = 0; i < 25; i++)
+            a0.CreateEntity(Entity(i), CombineBytesById(Position(i, i), IntComp(i)).data());
+        for (int i = 0; i < 5; i++)
+            a1.CreateEntity(Entity(100 + i), ToBytes(Position(i, i)));
+
+        EntityIterator<Entity, Position, std::optional<IntComp>> it({ &a0, &a1 });
+
+        std::vector<size_t> sizes;
+        size_t withInt = 0;
+        it.ForEachChunk(
+        [&](std::span<Entity> entities, std::span<Position> positions, std::span<IntComp> ints)
+        {
+            EXPECT_EQ(entities.size(), positions.size());
+            sizes.push_back(entities.size());
+            withInt += ints.size();
+
+            for (size_t i = 0; i < ints.size(); i++)
+            {
+                EXPECT_EQ(ints[i].value, positions[i].x);
+            }
+        });
+
+        EXPECT_EQ(sizes, (std::vector<size_t>{ 10, 10, 5, 5 }));
+        EXPECT_EQ(withInt, 25);
+    }
+
+    TEST(Archetype, ReleaseSpareChunks)
+    {
+        ComponentList cl = ComponentList::Create<Position>();
+        Archetype a(cl, ArchetypeInfo::ChunkSizeFor(cl, 4));
+
+        for (size_t i = 0; i < 40; i++)
+            a.CreateEntity(Entity(i));
+
+        EXPECT_EQ(a.ChunkCount(), 10);
+
+        // Emptying a single chunk keeps it around as a spare
+        for (size_t i = 0; i < 4; i++)
+            a.DestroyEntity(0, 0);
+
+        EXPECT_EQ(a.ChunkCount(), 10);
+        EXPECT_EQ(a.ActiveChunkIndex(), 8);
+
+        while (a.EntityCount() > 1)
+            a.DestroyEntity(0, 0);
+
+        EXPECT_EQ(a.ActiveChunkIndex(), 0);
+        EXPECT_LE(a.ChunkCount(), 1 + 2 * Archetype::MinSpareChunks);
+
+        for (size_t i = 0; i < 39; i++)
+            a.CreateEntity(Entity(100 + i));
+
+        EXPECT_EQ(a.EntityCount(), 40);
+        EXPECT_EQ(a.ChunkCount(), 10);
+    }
+
+    TEST(Archetype, ShrinkToFit)
+    {
+        ComponentList cl = ComponentList::Create<Position>();
+        Archetype a(cl, ArchetypeInfo::ChunkSizeFor(cl, 4));
+
+        for (size_t i = 0; i < 20; i++)
+        {
+            a.CreateEntity(Entity(i));
+            a.GetComponent<Position>(i).x = (int)i;
+        }
+        for (size_t i = 0; i < 6; i++)
+            a.DestroyEntity(1, 0);
+
+        size_t moved = 0;
+        a.ShrinkToFit([&](const Entity&, Index, Index) { moved++; });
+
+        EXPECT_EQ(moved, 0);
+        EXPECT_EQ(a.EntityCount(), 14);
+        EXPECT_EQ(a.ChunkCount(), 4);
+        EXPECT_EQ(a.ActiveChunkIndex(), 3);
+
+        for (size_t i = 0; i < a.EntityCount(); i++)
+        {
+            EXPECT_EQ(a.GetComponent<Position>(i).x, a.GetComponent<Entity>(i).id);
+        }
+
+        while (a.EntityCount() > 0)
+            a.DestroyEntity(0, 0);
+
+        a.ShrinkToFit([&](const Entity&, Index, Index) { moved++; });
+        EXPECT_EQ(a.ChunkCount(), 1);
+        EXPECT_EQ(a.ActiveChunkIndex(), 0);
+    }
+
+    TEST(Archetype, ChunkGrowth)
+    {
+        ComponentList cl = ComponentList::Create<Position, StructComponentA>();
+        Archetype a(cl);
+
+        EXPECT_EQ(a.m_Chunks[0]->GetInfo().chunkSize, MinChunkSize);
+
+        Index count = 0;
+        while (a.ChunkCount() < 6)
+        {
+            a.CreateEntity(Entity(count));
+            a.GetComponent<Position>(count).x = (int)count;
+            count++;
+        }
+
+        for (Index i = 1; i < a.ChunkCount(); i++)
+        {
+            const auto expected = std::min(MinChunkSize << i, DefaultChunkSize);
+            EXPECT_EQ(a.m_Chunks[i]->GetInfo().chunkSize, expected);
+            EXPECT_GT(a.m_Chunks[i]->Capacity(), 0);
+        }
+
+        // Swap-remove from the small chunks pulls entities out of the large ones
+        for (Index i = 0; i < 10; i++)
+            a.DestroyEntity(0, i * 3);
+
+        for (Index i = 0; i < a.EntityCount(); i++)
+        {
+            EXPECT_EQ(a.GetComponent<Position>(i).x, a.GetComponent<Entity>(i).id);
+        }
+    }
 } // namespace EVA::ECS
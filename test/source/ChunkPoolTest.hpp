@@ -0,0 +1,82 @@
+#pragma once
+
+#include "test.hpp"
+
+namespace EVA::ECS
+{
+    TEST(ChunkPool, AllocateFree)
+    {
+        ChunkPool pool;
+
+        Byte* a = pool.Allocate(DefaultChunkSize, CacheLineSize);
+        Byte* b = pool.Allocate(DefaultChunkSize, CacheLineSize);
+
+        EXPECT_NE(a, b);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(a) % CacheLineSize, 0);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(b) % CacheLineSize, 0);
+        EXPECT_EQ(pool.SlabCount(), 1);
+        EXPECT_EQ(pool.FreeBlockCount(), ChunkPool::SlabSize / DefaultChunkSize - 2);
+
+        pool.Free(a, DefaultChunkSize, CacheLineSize);
+        EXPECT_EQ(pool.Allocate(DefaultChunkSize, CacheLineSize), a);
+
+        pool.Free(a, DefaultChunkSize, CacheLineSize);
+        pool.Free(b, DefaultChunkSize, CacheLineSize);
+    }
+
+    TEST(ChunkPool, SizeClasses)
+    {
+        ChunkPool pool;
+
+        EXPECT_EQ(ChunkPool::BlockSize(1, 1), ChunkPool::MinBlockSize);
+        EXPECT_EQ(ChunkPool::BlockSize(192, CacheLineSize), 256);
+        EXPECT_EQ(ChunkPool::BlockSize(100, 128), 128);
+
+        Byte* small = pool.Allocate(192, CacheLineSize);
+        Byte* large = pool.Allocate(DefaultChunkSize, CacheLineSize);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(large) % CacheLineSize, 0);
+        EXPECT_EQ(pool.SlabCount(), 2);
+
+        // A freed block is only reused by its own size class
+        pool.Free(small, 192, CacheLineSize);
+        EXPECT_NE(pool.Allocate(DefaultChunkSize, CacheLineSize), small);
+        EXPECT_EQ(pool.Allocate(200, CacheLineSize), small);
+    }
+
+    TEST(ChunkPool, Trim)
+    {
+        ChunkPool pool;
+
+        std::vector<Byte*> blocks;
+        for (size_t i = 0; i < ChunkPool::SlabSize / DefaultChunkSize + 1; i++)
+        {
+            blocks.push_back(pool.Allocate(DefaultChunkSize, CacheLineSize));
+        }
+        EXPECT_EQ(pool.SlabCount(), 2);
+
+        pool.Free(blocks.back(), DefaultChunkSize, CacheLineSize);
+        blocks.pop_back();
+        pool.Trim();
+        EXPECT_EQ(pool.SlabCount(), 1);
+        EXPECT_EQ(pool.FreeBlockCount(), 0);
+
+        pool.Free(blocks.back(), DefaultChunkSize, CacheLineSize);
+        pool.Trim();
+        EXPECT_EQ(pool.SlabCount(), 1);
+    }
+
+    TEST(ChunkPool, ReuseArchetypeChunks)
+    {
+        ComponentList cl = ComponentList::Create<Position, Velocity>();
+        ArchetypeInfo ai(cl);
+
+        const Byte* data = nullptr;
+        {
+            ArchetypeChunk ac(ai);
+            data = ac.Data();
+        }
+
+        ArchetypeChunk ac(ai);
+        EXPECT_EQ(ac.Data(), data);
+    }
+} // namespace EVA::ECS
@@ -43,6 +43,15 @@ namespace EVA::ECS
         free(aData);
     }
 
+    TEST(ComponentMap, Tags)
+    {
+        EXPECT_TRUE(ComponentMap::IsTag(Comp0::GetType()));
+        EXPECT_FALSE(ComponentMap::IsTag(Position::GetType()));
+
+        EXPECT_EQ(ComponentMap::s_Info[Comp0::GetType().Get()].size, 0);
+        EXPECT_EQ(ComponentMap::s_Info[Position::GetType().Get()].size, sizeof(Position));
+    }
+
     TEST(ComponentList, Create)
     {
         ComponentList lA = ComponentList::Create<Comp1, Comp3, Comp2>();
@@ -66,6 +75,12 @@ namespace EVA::ECS
         cl.Remove<Comp0>();
         EXPECT_EQ(cl.Count(), 0);
         EXPECT_FALSE(cl.Contains(Comp0::GetType()));
+
+        // Adding twice or removing a missing type changes nothing, hash included
+        cl.Add<Comp0>().Add<Comp0>().Remove<Comp1>();
+        EXPECT_EQ(cl.Count(), 1);
+        EXPECT_EQ(cl, ComponentList::Create<Comp0>());
+        EXPECT_EQ(cl.Hash(), ComponentList::Create<Comp0>().Hash());
     }
 
     TEST(ComponentList, EQ)
@@ -174,6 +189,25 @@ namespace EVA::ECS
         EXPECT_EQ(map[l_25], 25);
     }
 
+    TEST(ComponentList, Iterate)
+    {
+        ComponentList cl = ComponentList::Create<Comp3, Comp0, Position, Comp5>();
+        EXPECT_EQ(cl.Count(), 4);
+
+        std::vector<ComponentType> types(cl.begin(), cl.end());
+        EXPECT_EQ(types.size(), 4);
+        EXPECT_TRUE(std::is_sorted(types.begin(), types.end()));
+
+        EXPECT_EQ(cl.GetTypes(), (std::set{ Comp3::GetType(), Comp0::GetType(), Position::GetType(), Comp5::GetType() }));
+
+        ComponentList removed = cl;
+        removed.Remove<Position>().Add<Position>();
+        EXPECT_EQ(removed.Hash(), cl.Hash());
+        EXPECT_EQ(removed, cl);
+
+        EXPECT_EQ(ComponentList().begin(), ComponentList().end());
+    }
+
     TEST(ComponentFilter, Add)
     {
         ComponentFilter f;
@@ -13,6 +13,49 @@ namespace EVA::ECS
         EXPECT_EQ(s, sizeof(int) + sizeof(long));
     }
 
+    TEST(Core, EntitySize)
+    {
+#ifdef EVA_ECS_COMPACT_ENTITY
+        EXPECT_EQ(sizeof(Entity), 8);
+        EXPECT_EQ(sizeof(EntityLocation), 12);
+#else
+        EXPECT_EQ(sizeof(Entity), sizeof(EntityId) + sizeof(EntityIndex));
+        EXPECT_EQ(sizeof(EntityLocation), 3 * sizeof(EntityIndex) + sizeof(EntityId));
+#endif
+    }
+
+    TEST(Core, EntityLocationRelease)
+    {
+        EntityLocation loc(1, 2, 3, 0);
+        const Entity e(0);
+        EXPECT_EQ(loc.archetype, 1);
+        EXPECT_EQ(loc.chunk, 2);
+        EXPECT_EQ(loc.position, 3);
+        EXPECT_TRUE(loc.Holds(e));
+
+        EXPECT_TRUE(loc.Release());
+        EXPECT_FALSE(loc.Holds(e));
+        EXPECT_EQ(loc.position, 3);
+
+#ifdef EVA_ECS_COMPACT_ENTITY
+        // A location is retired instead of wrapping back to handles it already gave out
+        loc.generation = std::numeric_limits<EntityGeneration>::max() - 2;
+        EXPECT_TRUE(loc.Release());
+        EXPECT_FALSE(loc.Release());
+
+        bool thrown = false;
+        try
+        {
+            EntityLocation(0, 0, size_t(1) << EntityLocation::PositionBits, 0);
+        }
+        catch (const std::length_error&)
+        {
+            thrown = true;
+        }
+        EXPECT_TRUE(thrown);
+#endif
+    }
+
     TEST(Core, PostAdd)
     {
         int a = 10;
@@ -101,6 +101,42 @@ namespace EVA::ECS
         }
     }
 
+    TEST(Engine, ReuseEntityIndex)
+    {
+        Engine engine;
+
+        auto a = engine.CreateEntityFromComponents(IntComp(1));
+        auto b = engine.CreateEntityFromComponents(IntComp(2));
+        engine.DeleteEntity(b);
+        engine.DeleteEntity(a);
+
+        // The freed index is reused, the id is not
+        auto c = engine.CreateEntityFromComponents(IntComp(3));
+        EXPECT_EQ(c.Index(), a.Index());
+        EXPECT_NE(c.id, a.id);
+        EXPECT_NE(c, a);
+        EXPECT_EQ(engine.GetComponent<IntComp>(c).value, 3);
+    }
+
+    TEST(Engine, ReuseEntityIndexPastMillion)
+    {
+        Engine engine;
+
+        constexpr size_t count = (size_t(1) << 20) + 10;
+        auto entities          = engine.CreateEntitiesFromComponents(count, IntComp(1));
+        engine.SetComponent(entities[count - 5], IntComp(2));
+        engine.DeleteEntity(entities[5]);
+
+        auto e = engine.CreateEntityFromComponents(IntComp(3));
+        EXPECT_EQ(e.Index(), entities[5].Index());
+        EXPECT_NE(e, entities[5]);
+        EXPECT_NE(e, entities[count - 5]);
+        EXPECT_NE(std::hash<Entity>{}(e), std::hash<Entity>{}(entities[count - 5]));
+        EXPECT_EQ(engine.GetComponent<IntComp>(e).value, 3);
+        EXPECT_EQ(engine.GetComponent<IntComp>(entities[count - 5]).value, 2);
+        EXPECT_EQ(engine.EntityCount(), count);
+    }
+
     TEST(Engine, GetComponent)
     {
         Engine engine;
@@ -488,7 +524,7 @@ namespace EVA::ECS
             size_t count = 0;
             for (auto [e, i, p] : it)
             {
-                ASSERT_EQ(i.value, e.id + 10000);
+                ASSERT_EQ(i.value, (int)e.id + 10000);
                 if (p == pData)
                 {
                     count++;
@@ -669,8 +705,596 @@ namespace EVA::ECS
             EXPECT_EQ(it.Count(), entityCount);
             for (auto [e] : it)
             {
-                ASSERT_EQ(e.id, e.index);
+                ASSERT_EQ(e.id, e.Index());
             }
         }
     }
+
+    TEST(Engine, ShrinkToFit)
+    {
+        Engine engine;
+
+        std::vector<Entity> entities;
+        for (int i = 0; i < 20000; i++)
+            entities.push_back(engine.CreateEntityFromComponents(Position(i, i), IntComp(i)));
+
+        auto& archetype         = engine.GetArchetype(engine.GetArchetypeIndex(ComponentList::Create<Position, IntComp>()).value());
+        const auto chunksAtPeak = archetype.ChunkCount();
+
+        for (size_t i = 0; i < entities.size(); i += 2)
+            engine.DeleteEntity(entities[i]);
+
+        engine.ShrinkToFit();
+
+        EXPECT_EQ(engine.EntityCount(), 10000);
+        EXPECT_LT(archetype.ChunkCount(), chunksAtPeak);
+        EXPECT_EQ(archetype.ChunkCount(), archetype.ActiveChunkIndex() + 1);
+
+        for (size_t i = 1; i < entities.size(); i += 2)
+        {
+            EXPECT_EQ(engine.GetComponent<Position>(entities[i]).x, (int)i);
+            EXPECT_EQ(engine.GetComponent<IntComp>(entities[i]).value, (int)i);
+        }
+    }
+
+    TEST(Engine, Tags)
+    {
+        Engine engine;
+
+        std::vector<Entity> entities;
+        for (int i = 0; i < 100; i++)
+            entities.push_back(engine.CreateEntityFromComponents(Position(i, i * 2), Comp0()));
+
+        for (size_t i = 0; i < entities.size(); i += 2)
+            engine.AddComponent<Comp1>(entities[i]);
+
+        EXPECT_EQ(EntityIterator<Entity>(engine.GetArchetypes<Comp0>()).Count(), 100);
+        EXPECT_EQ(EntityIterator<Entity>(engine.GetArchetypes<Comp0, Comp1>()).Count(), 50);
+
+        for (auto [e, p, t] : EntityIterator<Entity, Position, Comp1>(engine.GetArchetypes<Comp1>()))
+        {
+            EXPECT_EQ(p.x * 2, p.y);
+        }
+
+        for (size_t i = 0; i < entities.size(); i += 2)
+            engine.RemoveComponent<Comp0>(entities[i]);
+
+        EXPECT_EQ(EntityIterator<Entity>(engine.GetArchetypes<Comp0>()).Count(), 50);
+        for (size_t i = 0; i < entities.size(); i++)
+        {
+            EXPECT_EQ(engine.GetComponent<Position>(entities[i]), Position((int)i, (int)i * 2));
+        }
+    }
+
+    TEST(Engine, TransitionEdges)
+    {
+        Engine engine;
+
+        auto e0 = engine.CreateEntityFromComponents(Position(1, 2));
+        auto e1 = engine.CreateEntityFromComponents(Position(3, 4));
+
+        const auto from = engine.GetArchetypeIndex(ComponentList::Create<Position>()).value();
+        EXPECT_EQ(engine.GetArchetype(from).GetAddEdge(Velocity::GetType()).archetype, Archetype::Edge::None);
+
+        engine.AddComponent(e0, Velocity(5, 6));
+
+        const auto to = engine.GetArchetypeIndex(ComponentList::Create<Position, Velocity>()).value();
+        EXPECT_EQ(engine.GetArchetype(from).GetAddEdge(Velocity::GetType()).archetype, to);
+        EXPECT_EQ(engine.GetArchetype(to).GetRemoveEdge(Velocity::GetType()).archetype, from);
+
+        const auto& columns = engine.GetArchetype(from).GetAddEdge(Velocity::GetType()).columns;
+        EXPECT_EQ(columns.copy.size(), 2);
+        EXPECT_EQ(columns.added.size(), 1);
+
+        engine.AddComponent<Velocity>(e1);
+        EXPECT_EQ(engine.ArchetypeCount(), 2);
+        EXPECT_EQ(engine.GetComponent<Position>(e0), Position(1, 2));
+        EXPECT_EQ(engine.GetComponent<Velocity>(e0), Velocity(5, 6));
+        EXPECT_EQ(engine.GetComponent<Position>(e1), Position(3, 4));
+
+        engine.RemoveComponent<Velocity>(e0);
+        EXPECT_EQ(engine.GetArchetype(from).EntityCount(), 1);
+        EXPECT_EQ(engine.GetComponent<Position>(e0), Position(1, 2));
+        EXPECT_EQ(engine.GetComponent<Velocity>(e1), Velocity());
+    }
+
+    TEST(Engine, Queries)
+    {
+        Engine engine;
+        engine.CreateEntityFromComponents(Position(1, 2));
+
+        const auto& query = engine.GetQuery(ComponentFilter::Create<Position, Not<Velocity>>());
+        EXPECT_EQ(&query, &engine.GetQuery(ComponentFilter::Create<Position, Not<Velocity>>()));
+        EXPECT_EQ(query.archetypes.size(), 1);
+
+        engine.CreateEntityFromComponents(Position(3, 4), IntComp(5));
+        engine.CreateEntityFromComponents(Position(3, 4), Velocity(5, 6));
+        engine.CreateEntityFromComponents(IntComp(7));
+        EXPECT_EQ(engine.ArchetypeCount(), 4);
+        EXPECT_EQ(query.archetypes.size(), 2);
+
+        EXPECT_EQ(engine.GetArchetypes<Position>().size(), 3);
+        EXPECT_EQ((engine.GetArchetypes<Position, Not<Velocity>>().size()), 2);
+        EXPECT_EQ(engine.GetArchetypes(ComponentList::Create<IntComp>()).size(), 2);
+
+        auto e = engine.CreateEntityFromComponents(Velocity(1, 1));
+        EXPECT_EQ(engine.GetArchetypes<Velocity>().size(), 2);
+        engine.DeleteEntity(e);
+        EXPECT_EQ(engine.GetArchetypes<Velocity>().size(), 1);
+        EXPECT_EQ(engine.GetArchetypes<Velocity>(true).size(), 2);
+    }
+
+    TEST(Engine, CreateEntities)
+    {
+        static size_t s_Calls   = 0;
+        static size_t s_Created = 0;
+        class CountSystem : public System
+        {
+          public:
+            void Init() override { SubscribeToEntityEvents<Position>(); }
+            void Update() override {}
+            void OnEntitiesCreated(std::span<const Entity> entities) override
+            {
+                s_Calls++;
+                s_Created += entities.size();
+            }
+        };
+
+        Engine engine;
+        engine.AddSystem<CountSystem>();
+
+        auto single = engine.CreateEntity();
+        engine.DeleteEntity(single);
+
+        auto entities = engine.CreateEntitiesFromComponents(10000, Position(1, 2), IntComp(3));
+        EXPECT_EQ(entities.size(), 10000);
+        EXPECT_EQ(engine.EntityCount(), 10000);
+        EXPECT_EQ(s_Calls, 0);
+        engine.FlushEntityEvents();
+        EXPECT_EQ(s_Calls, 1);
+        EXPECT_EQ(s_Created, 10000);
+
+        // The freed location is reused first
+        EXPECT_EQ(entities[0].Index(), single.Index());
+
+        for (size_t i = 0; i < entities.size(); i++)
+        {
+            EXPECT_EQ(entities[i].Index(), i);
+            EXPECT_EQ(engine.GetComponent<Position>(entities[i]), Position(1, 2));
+            EXPECT_EQ(engine.GetComponent<IntComp>(entities[i]).value, 3);
+        }
+
+        auto defaults = engine.CreateEntities(ComponentList::Create<Position, IntComp>(), 100);
+        EXPECT_EQ(engine.GetComponent<Position>(defaults[99]), Position());
+        EXPECT_EQ(engine.ArchetypeCount(), 2);
+
+        EXPECT_EQ((EntityIterator<Entity, Position, IntComp>(engine.GetArchetypes<Position, IntComp>()).Count()), 10100);
+
+        EXPECT_EQ(engine.CreateEntities(ComponentList(), 0).size(), 0);
+    }
+
+    TEST(Engine, DestroyEntitiesByFilter)
+    {
+        static size_t s_Destroyed = 0;
+        class CountSystem : public System
+        {
+          public:
+            void Init() override { SubscribeToEntityEvents<>(); }
+            void Update() override {}
+            void OnEntityDestroyed(Entity) override { s_Destroyed++; }
+        };
+
+        Engine engine;
+        engine.AddSystem<CountSystem>();
+
+        auto moving = engine.CreateEntitiesFromComponents(5000, Position(1, 1), Velocity(1, 1));
+        auto still  = engine.CreateEntitiesFromComponents(3000, Position(2, 2));
+        auto ints   = engine.CreateEntitiesFromComponents(2000, Position(3, 3), IntComp(3));
+
+        engine.DestroyEntities(ComponentFilter::Create<Position, Not<Velocity>>());
+        engine.FlushEntityEvents();
+        EXPECT_EQ(s_Destroyed, 5000);
+        EXPECT_EQ(engine.EntityCount(), 5000);
+        EXPECT_EQ(engine.GetArchetypes<Position>().size(), 1);
+
+        const auto index = engine.GetArchetypeIndex(ComponentList::Create<Position>()).value();
+        EXPECT_EQ(engine.GetArchetype(index).EntityCount(), 0);
+        EXPECT_LE(engine.GetArchetype(index).ChunkCount(), 1 + Archetype::MinSpareChunks);
+
+        // Freed locations are reused
+        auto e = engine.CreateEntityFromComponents(IntComp(7));
+        EXPECT_EQ(engine.GetComponent<IntComp>(e).value, 7);
+        EXPECT_EQ(engine.GetComponent<Velocity>(moving[4999]), Velocity(1, 1));
+    }
+
+    TEST(Engine, EntityEvents)
+    {
+        static std::vector<std::vector<Entity>> s_Created;
+        static std::vector<std::vector<Entity>> s_Destroyed;
+        static size_t s_Unsubscribed = 0;
+        class VelocitySystem : public System
+        {
+          public:
+            void Init() override { SubscribeToEntityEvents<Velocity>(); }
+            void Update() override {}
+            void OnEntitiesCreated(std::span<const Entity> entities) override { s_Created.emplace_back(entities.begin(), entities.end()); }
+            void OnEntitiesDestroyed(std::span<const Entity> entities) override { s_Destroyed.emplace_back(entities.begin(), entities.end()); }
+        };
+        class UnsubscribedSystem : public System
+        {
+          public:
+            void Update() override {}
+            void OnEntityCreated(Entity) override { s_Unsubscribed++; }
+        };
+
+        Engine engine;
+        engine.AddSystem<VelocitySystem>();
+        engine.AddSystem<UnsubscribedSystem>();
+
+        std::vector<Entity> a, b;
+        for (int i = 0; i < 10; i++)
+        {
+            a.push_back(engine.CreateEntityFromComponents(Velocity(i, i)));
+            b.push_back(engine.CreateEntityFromComponents(Velocity(i, i), Position(i, i)));
+            engine.CreateEntityFromComponents(Position(i, i));
+        }
+
+        // One span per archetype, in creation order
+        engine.UpdateSystems();
+        EXPECT_EQ(s_Created.size(), 2);
+        EXPECT_TRUE(s_Created[0] == a);
+        EXPECT_TRUE(s_Created[1] == b);
+        EXPECT_EQ(s_Unsubscribed, 0);
+
+        engine.DeleteEntity(b[3]);
+        engine.DestroyEntities(ComponentFilter::Create<Not<Velocity>>());
+        EXPECT_TRUE(s_Destroyed.empty());
+
+        engine.UpdateSystems();
+        EXPECT_EQ(s_Created.size(), 2);
+        EXPECT_EQ(s_Destroyed.size(), 1);
+        EXPECT_EQ(s_Destroyed[0].size(), 1);
+        EXPECT_EQ(s_Destroyed[0][0].id, b[3].id);
+
+        // Entities that reuse freed locations are still delivered in creation order
+        std::vector<Entity> c;
+        for (int i = 0; i < 12; i++)
+        {
+            c.push_back(engine.CreateEntityFromComponents(Velocity(i, i)));
+        }
+        engine.UpdateSystems();
+        EXPECT_EQ(s_Created.size(), 3);
+        EXPECT_TRUE(s_Created[2] == c);
+    }
+
+    TEST(Engine, ComponentObservers)
+    {
+        Engine engine;
+
+        std::vector<size_t> added, removed, set;
+        engine.OnAdd<Velocity>([&](std::span<const Entity> entities) { added.push_back(entities.size()); });
+        engine.OnRemove<Velocity>([&](std::span<const Entity> entities) { removed.push_back(entities.size()); });
+        engine.OnSet<Velocity>([&](std::span<const Entity> entities) { set.push_back(entities.size()); });
+
+        auto entities = engine.CreateEntitiesFromComponents(100, Position(1, 1));
+        for (int i = 0; i < 10; i++)
+        {
+            engine.AddComponent<Velocity>(entities[i]);
+        }
+        for (int i = 10; i < 15; i++)
+        {
+            engine.AddComponent(entities[i], Velocity(1, 1));
+        }
+        engine.AddComponent<IntComp>(entities[20]);
+        EXPECT_TRUE(added.empty());
+
+        // One span per transition
+        engine.FlushEntityEvents();
+        EXPECT_TRUE((added == std::vector<size_t>{ 10, 5 }));
+        EXPECT_TRUE((set == std::vector<size_t>{ 5 }));
+        EXPECT_TRUE(removed.empty());
+
+        engine.SetComponent(entities[0], Velocity(2, 2));
+        engine.SetComponent(entities[1], Velocity(2, 2));
+        engine.GetComponent<Velocity>(entities[2]) = Velocity(2, 2);
+        engine.UpdateSystems();
+        EXPECT_TRUE((set == std::vector<size_t>{ 5, 2 }));
+        EXPECT_EQ(engine.GetComponent<Velocity>(entities[1]), Velocity(2, 2));
+
+        engine.RemoveComponentFromAll<Velocity>(ComponentFilter::Create<Velocity>());
+        engine.CreateEntitiesFromComponents(50, Velocity(3, 3));
+        engine.FlushEntityEvents();
+        EXPECT_TRUE((removed == std::vector<size_t>{ 15 }));
+        EXPECT_TRUE((added == std::vector<size_t>{ 10, 5, 50 }));
+        EXPECT_TRUE((set == std::vector<size_t>{ 5, 2, 50 }));
+
+        engine.DestroyEntities(ComponentFilter::Create<Velocity>());
+        engine.DestroyEntities(entities);
+        engine.FlushEntityEvents();
+        EXPECT_TRUE((removed == std::vector<size_t>{ 15, 50 }));
+        EXPECT_EQ(added.size(), 3);
+    }
+
+    TEST(Engine, EnableableComponents)
+    {
+        Engine engine;
+
+        std::vector<Entity> entities;
+        for (int i = 0; i < 5000; i++)
+        {
+            entities.push_back(engine.CreateEntityFromComponents(Position(i, i), Controller(i)));
+        }
+
+        size_t alive = entities.size();
+        std::set<int> disabled;
+        for (int i = 0; i < 5000; i++)
+        {
+            if (i % 3 == 0 || (i >= 100 && i < 300) || i == 4999)
+            {
+                engine.SetEnabled<Controller>(entities[i], false);
+                disabled.insert(i);
+            }
+        }
+        EXPECT_EQ(engine.ArchetypeCount(), 1);
+        EXPECT_FALSE(engine.IsEnabled<Controller>(entities[0]));
+        EXPECT_TRUE(engine.IsEnabled<Controller>(entities[1]));
+        EXPECT_TRUE(engine.IsEnabled<Position>(entities[0]));
+
+        const auto check = [&]()
+        {
+            size_t count = 0;
+            for (auto [e, c] : engine.GetEntityIterator<Controller>())
+            {
+                EXPECT_TRUE(engine.IsEnabled<Controller>(e));
+                EXPECT_FALSE(disabled.contains(c.value));
+                count++;
+            }
+            EXPECT_EQ(count, alive - disabled.size());
+
+            size_t chunkCount = 0;
+            engine.GetEntityIterator<const Controller, Position>().ForEachChunk(
+            [&](std::span<Entity> e, std::span<const Controller> c, std::span<Position> p)
+            {
+                EXPECT_EQ(e.size(), c.size());
+                for (size_t i = 0; i < c.size(); i++)
+                {
+                    EXPECT_EQ(c[i].value, p[i].x);
+                }
+                chunkCount += c.size();
+            });
+            EXPECT_EQ(chunkCount, alive - disabled.size());
+
+            std::atomic<size_t> processed = 0;
+            engine.GetEntityIterator<Controller>().Process(4, [&](auto t) { processed += engine.IsEnabled<Controller>(std::get<0>(t)); });
+            EXPECT_EQ(processed.load(), alive - disabled.size());
+        };
+        check();
+
+        // Runs of enabled entities from the same chunk stay in one range when splitting by chunks
+        {
+            const auto& archetype = engine.GetArchetype(engine.GetArchetypeIndex(ComponentList::Create<Position, Controller>()).value());
+            const auto chunkOf    = [&](const Controller& c)
+            {
+                const auto* p = reinterpret_cast<const Byte*>(&c);
+                for (Index i = 0; i < archetype.ChunkCount(); i++)
+                {
+                    const auto* data = archetype.m_Chunks[i]->Data();
+                    if (p >= data && p < data + archetype.m_Chunks[i]->GetInfo().chunkSize)
+                        return i;
+                }
+                return archetype.ChunkCount();
+            };
+
+            auto it = engine.GetEntityIterator<Controller>();
+            std::vector<std::set<Index>> rangeChunks;
+            for (auto [b, e] : it.Split(8, SplitMode::Chunks))
+            {
+                auto& chunks = rangeChunks.emplace_back();
+                for (auto i = b; i != e; ++i)
+                {
+                    chunks.insert(chunkOf(std::get<1>(*i)));
+                }
+            }
+            EXPECT_GT(rangeChunks.size(), 1);
+
+            std::set<Index> seen;
+            for (const auto& chunks : rangeChunks)
+            {
+                for (const auto c : chunks)
+                {
+                    EXPECT_TRUE(seen.insert(c).second);
+                }
+            }
+        }
+
+        // Disabled components are still there for iterators that do not require them
+        EXPECT_EQ(engine.GetEntityIterator<Position>().Count(), 5000);
+        EXPECT_EQ((EntityIterator<Entity, std::optional<Controller>>(engine.GetArchetypes<Position>()).Count()), 5000);
+
+        // The bits follow entities that are moved
+        engine.AddComponent<Velocity>(entities[3]);
+        engine.AddComponent<Velocity>(entities[4]);
+        engine.DeleteEntity(entities[10]);
+        alive--;
+        EXPECT_FALSE(engine.IsEnabled<Controller>(entities[3]));
+        EXPECT_TRUE(engine.IsEnabled<Controller>(entities[4]));
+        EXPECT_FALSE(engine.IsEnabled<Controller>(entities[4999]));
+        check();
+
+        for (const auto i : disabled)
+        {
+            engine.SetEnabled<Controller>(entities[i], true);
+        }
+        EXPECT_EQ(engine.GetEntityIterator<Controller>().Count(), alive);
+    }
+
+    TEST(Engine, DestroyEntitiesSpan)
+    {
+        Engine engine;
+
+        std::vector<Entity> entities;
+        for (int i = 0; i < 3000; i++)
+        {
+            entities.push_back(engine.CreateEntityFromComponents(IntComp(i)));
+            entities.push_back(engine.CreateEntityFromComponents(IntComp(i), Position(i, i)));
+        }
+
+        std::vector<Entity> destroy;
+        std::vector<Entity> keep;
+        for (size_t i = 0; i < entities.size(); i++)
+        {
+            (i % 3 == 0 || i > 5000 ? destroy : keep).push_back(entities[i]);
+        }
+
+        engine.DestroyEntities(destroy);
+        EXPECT_EQ(engine.EntityCount(), keep.size());
+
+        for (const auto& e : keep)
+        {
+            const auto& i = engine.GetComponent<IntComp>(e);
+            EXPECT_EQ(i.value, static_cast<int>(e.id / 2));
+        }
+
+        size_t count = 0;
+        for (auto [e, i] : EntityIterator<Entity, IntComp>(engine.GetArchetypes<IntComp>()))
+        {
+            EXPECT_EQ(i.value, static_cast<int>(e.id / 2));
+            count++;
+        }
+        EXPECT_EQ(count, keep.size());
+    }
+
+    TEST(Engine, AddRemoveComponentToAll)
+    {
+        Engine engine;
+
+        auto moving = engine.CreateEntitiesFromComponents(5000, Position(1, 2), Velocity(3, 4));
+        auto still  = engine.CreateEntitiesFromComponents(3000, Position(5, 6));
+
+        engine.AddComponentToAll(ComponentFilter::Create<Position>(), IntComp(7));
+        EXPECT_EQ(EntityIterator<Entity>(engine.GetArchetypes<IntComp>()).Count(), 8000);
+        EXPECT_EQ(EntityIterator<Entity>(engine.GetArchetypes<Position, Not<IntComp>>()).Count(), 0);
+
+        for (const auto& e : moving)
+        {
+            EXPECT_EQ(engine.GetComponent<Position>(e), Position(1, 2));
+            EXPECT_EQ(engine.GetComponent<Velocity>(e), Velocity(3, 4));
+            EXPECT_EQ(engine.GetComponent<IntComp>(e).value, 7);
+        }
+
+        engine.RemoveComponentFromAll<Position>(ComponentFilter::Create<Velocity>());
+        EXPECT_EQ(EntityIterator<Entity>(engine.GetArchetypes<Position>()).Count(), 3000);
+        for (const auto& e : moving)
+        {
+            EXPECT_EQ(engine.GetComponent<Velocity>(e), Velocity(3, 4));
+            EXPECT_FALSE(engine.TryGetComponent<Position>(e).has_value());
+        }
+        for (const auto& e : still)
+        {
+            EXPECT_EQ(engine.GetComponent<Position>(e), Position(5, 6));
+            EXPECT_EQ(engine.GetComponent<IntComp>(e).value, 7);
+        }
+    }
+
+    TEST(Engine, AddTagToAll)
+    {
+        Engine engine;
+
+        auto entities = engine.CreateEntitiesFromComponents(10000, Position(1, 2));
+        const auto from = engine.GetArchetypeIndex(ComponentList::Create<Position>()).value();
+        const auto* chunk = engine.GetArchetype(from).m_Chunks[0].get();
+
+        // The tagged archetype is empty, so the chunks are handed over as they are
+        engine.AddComponentToAll<Comp0>(ComponentFilter::Create<Position>());
+        const auto to = engine.GetArchetypeIndex(ComponentList::Create<Position, Comp0>()).value();
+        EXPECT_EQ(engine.GetArchetype(to).m_Chunks[0].get(), chunk);
+        EXPECT_EQ(engine.GetArchetype(to).EntityCount(), 10000);
+        EXPECT_EQ(engine.GetArchetype(from).EntityCount(), 0);
+
+        for (auto [e, p, t] : EntityIterator<Entity, Position, Comp0>(engine.GetArchetypes<Comp0>()))
+        {
+            EXPECT_EQ(p, Position(1, 2));
+        }
+        for (size_t i = 0; i < entities.size(); i += 100)
+        {
+            EXPECT_EQ(engine.GetComponent<Position>(entities[i]), Position(1, 2));
+        }
+
+        // Not empty anymore, so the entities are copied
+        engine.CreateEntityFromComponents(Position(3, 4));
+        engine.RemoveComponentFromAll<Comp0>(ComponentFilter::Create<Comp0>());
+        EXPECT_EQ(engine.GetArchetype(from).EntityCount(), 10001);
+        EXPECT_EQ(engine.GetArchetype(to).EntityCount(), 0);
+        EXPECT_EQ(engine.GetComponent<Position>(entities[9999]), Position(1, 2));
+
+        engine.DeleteEntity(entities[0]);
+        EXPECT_EQ(engine.GetComponent<Position>(entities[1]), Position(1, 2));
+    }
+
+    TEST(Engine, ChangeComponents)
+    {
+        Engine engine;
+
+        auto e     = engine.CreateEntity();
+        auto other = engine.CreateEntityFromComponents(IntComp(1));
+
+        engine.AddComponents(e, Velocity(3, 4), Comp1(), Position(1, 2), IntComp(5));
+        EXPECT_EQ(engine.ArchetypeCount(), 3);
+        EXPECT_EQ(engine.GetComponent<Position>(e), Position(1, 2));
+        EXPECT_EQ(engine.GetComponent<Velocity>(e), Velocity(3, 4));
+        EXPECT_EQ(engine.GetComponent<IntComp>(e).value, 5);
+
+        engine.RemoveComponents<Velocity, Comp1>(e);
+        EXPECT_EQ(engine.ArchetypeCount(), 4);
+        EXPECT_EQ(engine.GetComponent<Position>(e), Position(1, 2));
+        EXPECT_FALSE(engine.TryGetComponent<Velocity>(e).has_value());
+
+        engine.ChangeComponents(e, ComponentList::Create<Velocity>(), ComponentList::Create<IntComp>());
+        EXPECT_EQ(engine.GetComponent<Position>(e), Position(1, 2));
+        EXPECT_EQ(engine.GetComponent<Velocity>(e), Velocity());
+        EXPECT_FALSE(engine.TryGetComponent<IntComp>(e).has_value());
+
+        engine.AddComponents<Comp2, Comp3>(other);
+        EXPECT_EQ(engine.GetComponent<IntComp>(other).value, 1);
+        EXPECT_EQ(EntityIterator<Entity>(engine.GetArchetypes<Comp2, Comp3>()).Count(), 1);
+
+        // Components the entity already has, or lacks, do not create new archetypes
+        const auto archetypes = engine.ArchetypeCount();
+        engine.AddComponent(e, Position(7, 8));
+        engine.AddComponent<Velocity>(e);
+        engine.RemoveComponent<IntComp>(e);
+        engine.ChangeComponents(e, ComponentList(), ComponentList::Create<IntComp>());
+        EXPECT_EQ(engine.ArchetypeCount(), archetypes);
+        EXPECT_EQ(engine.GetComponent<Position>(e), Position(7, 8));
+        EXPECT_EQ(engine.GetComponent<Velocity>(e), Velocity());
+
+        // Once both directions are cached, moving between two archetypes does not allocate
+        const auto swapA = ComponentList::Create<Comp2, Comp3>();
+        const auto swapB = ComponentList::Create<Comp4, Comp5>();
+        engine.ChangeComponents(e, swapA, ComponentList());
+        engine.ChangeComponents(e, swapB, swapA);
+        engine.ChangeComponents(e, swapA, swapB);
+
+        s_AllocationCount  = 0;
+        s_CountAllocations = true;
+        for (size_t i = 0; i < 10; i++)
+        {
+            engine.ChangeComponents(e, swapB, swapA);
+            engine.ChangeComponents(e, swapA, swapB);
+        }
+        s_CountAllocations = false;
+        EXPECT_EQ(s_AllocationCount, 0);
+        EXPECT_EQ(engine.ArchetypeCount(), archetypes + 2);
+        EXPECT_EQ(engine.GetComponent<Position>(e), Position(7, 8));
+
+        // Values of components the entity already has are set, the rest fill the new columns
+        auto mixed = engine.CreateEntityFromComponents(Position(1, 2));
+        engine.AddComponents(mixed, Position(7, 8), Velocity(3, 4));
+        EXPECT_EQ(engine.GetComponent<Position>(mixed), Position(7, 8));
+        EXPECT_EQ(engine.GetComponent<Velocity>(mixed), Velocity(3, 4));
+
+        engine.AddComponents(mixed, Velocity(5, 6), Position(9, 10));
+        EXPECT_EQ(engine.GetComponent<Position>(mixed), Position(9, 10));
+        EXPECT_EQ(engine.GetComponent<Velocity>(mixed), Velocity(5, 6));
+    }
 } // namespace EVA::ECS
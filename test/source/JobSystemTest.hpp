@@ -0,0 +1,54 @@
+#pragma once
+
+#include "test.hpp"
+
+namespace EVA::ECS
+{
+    TEST(JobSystem, ParallelFor)
+    {
+        JobSystem jobs(4);
+        EXPECT_EQ(jobs.WorkerCount(), 4);
+
+        std::vector<std::atomic<int>> hits(1000);
+        jobs.ParallelFor(hits.size(), [&](size_t i) { hits[i]++; });
+
+        for (const auto& hit : hits)
+        {
+            EXPECT_EQ(hit.load(), 1);
+        }
+    }
+
+    TEST(JobSystem, SingleWorker)
+    {
+        JobSystem jobs(1);
+        EXPECT_EQ(jobs.WorkerCount(), 1);
+
+        const auto thread = std::this_thread::get_id();
+        std::vector<size_t> order;
+        jobs.ParallelFor(100,
+        [&](size_t i)
+        {
+            EXPECT_EQ(std::this_thread::get_id(), thread);
+            order.push_back(i);
+        });
+
+        EXPECT_EQ(order.size(), 100);
+        EXPECT_TRUE(std::is_sorted(order.begin(), order.end()));
+    }
+
+    TEST(JobSystem, Nested)
+    {
+        JobSystem jobs(3);
+
+        std::atomic<size_t> sum = 0;
+        jobs.ParallelFor(8, [&](size_t i) { jobs.ParallelFor(8, [&](size_t j) { sum += i * 8 + j; }); });
+        EXPECT_EQ(sum, 64 * 63 / 2);
+
+        jobs.SetWorkerCount(2);
+        EXPECT_EQ(jobs.WorkerCount(), 2);
+
+        sum = 0;
+        jobs.ParallelFor(64, [&](size_t i) { sum += i; });
+        EXPECT_EQ(sum, 64 * 63 / 2);
+    }
+} // namespace EVA::ECS
@@ -35,6 +35,142 @@ namespace EVA::ECS
         EXPECT_EQ(s_Update, 6);
     }
 
+    TEST(System, ForEachChunk)
+    {
+        class MovementSystem : public System
+        {
+          public:
+            virtual void Update() override
+            {
+                ForEachChunk<Position, Velocity>(
+                [](std::span<Entity> entities, std::span<Position> positions, std::span<Velocity> velocities)
+                {
+                    for (size_t i = 0; i < entities.size(); i++)
+                    {
+                        positions[i].x += velocities[i].x;
+                        positions[i].y += velocities[i].y;
+                    }
+                });
+            }
+        };
+
+        Engine engine;
+        for (int i = 0; i < 10000; i++)
+        {
+            engine.CreateEntityFromComponents(Position(i, 0), Velocity(1, 2));
+        }
+        engine.CreateEntityFromComponents(Position(0, 0));
+
+        engine.AddSystem<MovementSystem>();
+        for (size_t i = 0; i < 10; i++)
+        {
+            engine.UpdateSystems();
+        }
+
+        int i = 0;
+        for (auto [e, p, v] : EntityIterator<Entity, Position, Velocity>(engine.GetArchetypes<Position, Velocity>()))
+        {
+            EXPECT_EQ(p, Position(i++ + 10, 20));
+        }
+        EXPECT_EQ(i, 10000);
+    }
+
+    TEST(System, ChangedFilter)
+    {
+        static size_t s_Seen = 0;
+        class SyncSystem : public System
+        {
+          public:
+            void Init() override { Reads<Position, Changed<Position>>(); }
+            void Update() override { s_Seen = GetEntityIterator<const Position, Changed<Position>>().Count(); }
+        };
+
+        Engine engine;
+        engine.AddSystem<SyncSystem>();
+
+        // Enough to span several chunks with either entity layout
+        auto still  = engine.CreateEntitiesFromComponents(4000, Position(1, 1));
+        auto moving = engine.CreateEntitiesFromComponents(10, Position(1, 1), Velocity(1, 1));
+
+        engine.UpdateSystems();
+        EXPECT_EQ(s_Seen, 4010);
+
+        // Reading is not a change
+        engine.UpdateSystems();
+        EXPECT_EQ(s_Seen, 0);
+
+        // Only the chunk that was written
+        engine.GetComponent<Position>(moving[3]).x = 5;
+        engine.UpdateSystems();
+        EXPECT_EQ(s_Seen, 10);
+
+        for (auto [e, v] : engine.GetEntityIterator<Velocity>())
+        {
+            v.x = 2;
+        }
+        engine.UpdateSystems();
+        EXPECT_EQ(s_Seen, 0);
+
+        for (auto [e, p, v] : engine.GetEntityIterator<Position, Velocity>())
+        {
+            p.x += v.x;
+        }
+        engine.AddComponent<IntComp>(moving[0]);
+        engine.UpdateSystems();
+        EXPECT_EQ(s_Seen, 10);
+
+        engine.DeleteEntity(still[0]);
+        engine.UpdateSystems();
+        EXPECT_GT(s_Seen, 0);
+        EXPECT_LT(s_Seen, 3999);
+    }
+
+    TEST(System, ReadOnlyAccess)
+    {
+        static size_t s_Seen = 0;
+        class ReadSystem : public System
+        {
+          public:
+            void Init() override { Reads<Position, Velocity>(); }
+            void Update() override
+            {
+                for (auto [e, p, v] : GetEntityIterator<const Position, std::optional<const Velocity>>())
+                {
+                    static_assert(std::is_same_v<decltype(p), const Position&>);
+                    static_assert(std::is_same_v<decltype(v), OptionalRef<const Velocity>>);
+                }
+                ForEachChunk<const Position>([](std::span<Entity>, std::span<const Position>) {});
+            }
+        };
+        class SyncSystem : public System
+        {
+          public:
+            void Init() override { Reads<Changed<Position>>(); }
+            void Update() override { s_Seen = GetEntityIterator<Changed<Position>>().Count(); }
+        };
+
+        const auto filter = ComponentFilter::Create<const Position, Velocity, std::optional<const IntComp>>();
+        EXPECT_EQ(filter.GetWritten(), ComponentList::Create<Velocity>());
+        EXPECT_TRUE(filter == (ComponentFilter::Create<Position, Velocity, std::optional<IntComp>>()));
+
+        Engine engine;
+        auto* read = engine.AddSystem<ReadSystem>();
+        auto* sync = engine.AddSystem<SyncSystem>();
+        EXPECT_FALSE(read->ConflictsWith(*sync));
+
+        auto e = engine.CreateEntityFromComponents(Position(1, 2), Velocity(3, 4));
+        engine.UpdateSystems();
+        EXPECT_EQ(s_Seen, 1);
+
+        EXPECT_EQ(engine.GetComponent<const Position>(e), Position(1, 2));
+        engine.UpdateSystems();
+        EXPECT_EQ(s_Seen, 0);
+
+        engine.GetComponent<Position>(e).x = 5;
+        engine.UpdateSystems();
+        EXPECT_EQ(s_Seen, 1);
+    }
+
     TEST(System, MovementSystem)
     {
         class MovementSystem : public System
@@ -78,6 +214,34 @@ namespace EVA::ECS
         }
     }
 
+    TEST(System, NestedQueries)
+    {
+        static size_t s_Pairs = 0;
+        class PairSystem : public System
+        {
+          public:
+            void Update() override
+            {
+                s_Pairs = 0;
+                for (auto [a, p] : GetEntityIterator<const Position>())
+                {
+                    for (auto [b, q] : GetEntityIterator<const Position>())
+                        s_Pairs += p.x * q.y;
+                }
+
+                // The cached iterator is the same object on every call
+                EXPECT_EQ(&GetCachedEntityIterator<const Position>(), &GetCachedEntityIterator<const Position>());
+            }
+        };
+
+        Engine engine;
+        engine.CreateEntitiesFromComponents(10, Position(1, 1));
+        engine.AddSystem<PairSystem>();
+
+        engine.UpdateSystems();
+        EXPECT_EQ(s_Pairs, 100);
+    }
+
     TEST(System, LinearGravitySystem)
     {
         class LinearGravitySystem : public System
@@ -140,4 +304,157 @@ namespace EVA::ECS
             EXPECT_EQ(p.y, -100 + (int)e.id * 100);
         }
     }
+
+    TEST(System, UpdateSystemsParallel)
+    {
+        class MoveSystem : public System
+        {
+          public:
+            void Init() override
+            {
+                Reads<Velocity>();
+                Writes<Position>();
+            }
+            void Update() override
+            {
+                for (auto [e, p, v] : GetEntityIterator<Position, const Velocity>())
+                {
+                    p.x += v.x;
+                }
+            }
+        };
+
+        class CountSystem : public System
+        {
+          public:
+            void Init() override { Writes<IntComp, Not<Position>>(); }
+            void Update() override
+            {
+                for (auto [e, i] : GetEntityIterator<IntComp>())
+                {
+                    i.value++;
+                }
+            }
+        };
+
+        class CheckSystem : public System
+        {
+          public:
+            void Init() override { Reads<Position, std::optional<IntComp>>(); }
+            void Update() override
+            {
+                for (auto [e, p, i] : GetEntityIterator<const Position, const IntComp>())
+                {
+                    EXPECT_EQ(p.x, i.value);
+                }
+            }
+        };
+
+        class UndeclaredSystem : public System
+        {
+          public:
+            void Update() override {}
+        };
+
+        Engine engine;
+        Entity last;
+        for (int i = 0; i < 1000; i++)
+        {
+            last = engine.CreateEntityFromComponents(Position(0, 0), Velocity(1, 0), IntComp(0));
+        }
+
+        auto* move  = engine.AddSystem<MoveSystem>();
+        auto* count = engine.AddSystem<CountSystem>();
+        auto* check = engine.AddSystem<CheckSystem>();
+
+        EXPECT_FALSE(move->ConflictsWith(*count));
+        EXPECT_TRUE(check->ConflictsWith(*move));
+        EXPECT_TRUE(check->ConflictsWith(*count));
+        EXPECT_FALSE(count->GetWrites().Contains(Position::GetType()));
+
+        EXPECT_EQ(engine.GetSystemLevels().size(), 2);
+        EXPECT_EQ(engine.GetSystemLevels()[0], (std::vector<System*>{ move, count }));
+
+        for (size_t i = 0; i < 10; i++)
+        {
+            engine.UpdateSystemsParallel();
+        }
+        EXPECT_EQ(engine.GetComponent<Position>(last).x, 10);
+
+        auto* undeclared = engine.AddSystem<UndeclaredSystem>();
+        EXPECT_TRUE(undeclared->ConflictsWith(*check));
+        EXPECT_EQ(engine.GetSystemLevels().size(), 3);
+        engine.UpdateSystemsParallel();
+    }
+
+    TEST(System, NoAllocationsInSteadyState)
+    {
+        class MoveSystem : public System
+        {
+          public:
+            void Init() override { Writes<Position, std::optional<Velocity>>(); }
+            void Update() override
+            {
+                for (auto [e, p, v] : GetCachedEntityIterator<Position, std::optional<Velocity>>())
+                {
+                    if (v)
+                        p.x += v->x;
+                }
+            }
+        };
+
+        class ChunkSystem : public System
+        {
+          public:
+            void Init() override { Writes<IntComp, Not<Velocity>>(); }
+            void Update() override
+            {
+                ForEachChunk<IntComp, Not<Velocity>>(
+                [](std::span<Entity>, std::span<IntComp> ints)
+                {
+                    for (auto& i : ints)
+                        i.value++;
+                });
+            }
+        };
+
+        class ProcessSystem : public System
+        {
+          public:
+            void Init() override { Writes<Velocity>(); }
+            void Update() override
+            {
+                GetCachedEntityIterator<Velocity>().Process(4, [](auto t) { std::get<1>(t).y++; }, SplitMode::Chunks);
+            }
+        };
+
+        Engine engine;
+        for (int i = 0; i < 5000; i++)
+        {
+            engine.CreateEntityFromComponents(Position(0, 0), Velocity(1, 0));
+            engine.CreateEntityFromComponents(Position(0, 0), IntComp(i));
+        }
+
+        engine.AddSystem<MoveSystem>();
+        engine.AddSystem<ChunkSystem>();
+        engine.AddSystem<ProcessSystem>();
+
+        // Let the cached queries and job queues grow
+        for (size_t i = 0; i < 3; i++)
+        {
+            engine.UpdateSystems();
+            engine.UpdateSystemsParallel();
+        }
+
+        s_AllocationCount  = 0;
+        s_CountAllocations = true;
+        for (size_t i = 0; i < 10; i++)
+        {
+            engine.UpdateSystems();
+            engine.UpdateSystemsParallel();
+        }
+        s_CountAllocations = false;
+
+        EXPECT_EQ(s_AllocationCount.load(), 0);
+    }
 } // namespace EVA::ECS
@@ -0,0 +1,24 @@
+// Replacement allocation functions for the allocation counting tests, kept out of main_test.cpp so GCC
+// cannot inline them into the tests and flag their malloc and free as mismatched with new and delete
+
+#include "allocation_hooks.hpp"
+
+#include <cstdlib>
+#include <new>
+
+void* operator new(size_t size)
+{
+    if (s_CountAllocations)
+        s_AllocationCount++;
+
+    if (void* p = std::malloc(size == 0 ? 1 : size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { operator delete(p); }
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+void operator delete[](void* p, size_t) noexcept { operator delete(p); }
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Counted by the replacement operator new in allocation_hooks.cpp while s_CountAllocations is set
+inline std::atomic<bool> s_CountAllocations{ false };
+inline std::atomic<size_t> s_AllocationCount{ 0 };
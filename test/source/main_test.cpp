@@ -1,9 +1,11 @@
 #include "ArchetypeChunkTest.hpp"
 #include "ArchetypeTest.hpp"
+#include "ChunkPoolTest.hpp"
 #include "CommandQueueTest.hpp"
 #include "ComponentTest.hpp"
 #include "CoreTest.hpp"
 #include "EngineTest.hpp"
+#include "JobSystemTest.hpp"
 #include "SystemTest.hpp"
 
 /*
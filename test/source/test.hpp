@@ -4,6 +4,8 @@
 
 #include "ecs/ecs.hpp"
 
+#include "allocation_hooks.hpp"
+
 struct Position
 {
     EVA_ECS_REGISTER_COMPONENT(Position);
@@ -56,6 +58,21 @@ struct IntComp
 inline bool operator==(const IntComp& lhs, const IntComp& rhs) { return lhs.value == rhs.value; }
 inline bool operator!=(const IntComp& lhs, const IntComp& rhs) { return !(lhs == rhs); }
 
+struct Controller
+{
+    EVA_ECS_REGISTER_COMPONENT(Controller);
+    static constexpr bool Enableable = true;
+
+    int value;
+    Controller() : value(0) {}
+    Controller(int v) : value(v) {}
+};
+
+struct alignas(128) AlignedComp
+{
+    EVA_ECS_REGISTER_COMPONENT(AlignedComp);
+    float values[4];
+};
 
 struct Comp0
 {